@@ -7,7 +7,24 @@
         "sources": [
             "src/main.cpp",
             "src/node-canal.cpp",
-            "src/canalif.cpp"
+            "src/canalif.cpp",
+            "src/j1939.cpp",
+            "src/vscpl1.cpp",
+            "src/cyclic.cpp",
+            "src/reqmatch.cpp",
+            "src/canalworkers.cpp",
+            "src/framering.cpp",
+            "src/framestream.cpp",
+            "src/broadcast.cpp",
+            "src/rtsched.cpp",
+            "src/coalesce.cpp",
+            "src/jsonvalue.cpp",
+            "src/dbc.cpp",
+            "src/idstats.cpp",
+            "src/busload.cpp",
+            "src/statuswatch.cpp",
+            "src/txqueue.cpp",
+            "src/shaper.cpp"
         ],
         'include_dirs': [
             "<!@(node -p \"require('node-addon-api').include\")",
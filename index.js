@@ -31,5 +31,70 @@
 
 "use strict";
 
+const { Readable } = require('stream');
 const CANAL = require('bindings')('nodecanal'); 
+
+// Start the native frame stream and throw if it can't be started
+function startStream(can, options) {
+  const rv = can.startStream({ capacity: options.capacity || 4096 });
+  if (CANAL.CANAL_ERROR_SUCCESS !== rv) {
+    const err = new Error("Failed to start frame stream");
+    err.code = rv;
+    throw err;
+  }
+}
+
+// Read the next batch, as frame objects or as columns
+function readNext(can, batchSize, maxLatencyMs, columnar) {
+  return columnar ? can.readColumns(batchSize, maxLatencyMs) :
+                    can.readBatch(batchSize, maxLatencyMs);
+}
+
+// Number of frames in a batch from readNext
+function batchLength(batch) {
+  return (undefined !== batch.count) ? batch.count : batch.length;
+}
+
+// for await (const batch of can.frames({ batchSize, maxLatencyMs }))
+CANAL.CNodeCanal.prototype.frames = async function* (options = {}) {
+  const batchSize = options.batchSize || 64;
+  const maxLatencyMs = options.maxLatencyMs || 10;
+
+  startStream(this, options);
+  try {
+    for (;;) {
+      const batch = await readNext(this, batchSize, maxLatencyMs, options.columnar);
+      if (0 === batchLength(batch)) {
+        return;   // Stream stopped
+      }
+      yield batch;
+    }
+  }
+  finally {
+    this.stopStream();
+  }
+};
+
+// Readable in object mode, each chunk is a batch (array or columns) of frames
+CANAL.CNodeCanal.prototype.createReadStream = function (options = {}) {
+  const can = this;
+  const batchSize = options.batchSize || 64;
+  const maxLatencyMs = options.maxLatencyMs || 10;
+
+  startStream(can, options);
+  return new Readable({
+    objectMode: true,
+    highWaterMark: options.highWaterMark || 1,
+    read() {
+      readNext(can, batchSize, maxLatencyMs, options.columnar).then(
+        (batch) => this.push(batchLength(batch) ? batch : null),
+        (err) => this.destroy(err));
+    },
+    destroy(err, callback) {
+      can.stopStream();
+      callback(err);
+    }
+  });
+};
+
 module.exports = CANAL;
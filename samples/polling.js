@@ -55,19 +55,20 @@ var id = setInterval(checkMessage, 1000 );
 
 function checkMessage()
 {
-    var count;
-    if ( count = can.dataAvailable() ) {
-        console.log("count = ", count); 
-        var rv = can.receive( (canmsg) => {
+    // Everything waiting in one call
+    var msgs = can.receiveMany(100);
+    if ( msgs.length ) {
+        console.log("count = ", msgs.length);
+        for ( const canmsg of msgs ) {
             console.log("Message received:", canmsg)
             if ( canmsg.id == 0x999 ) {
                 console.log('CNodeCanal close : ',can.close());
                 process.exit();
-              }
-        });
+            }
+        }
     }
     else {
-        console.log("No messages " + count);
+        console.log("No messages");
     }
 }
 
@@ -0,0 +1,79 @@
+///////////////////////////////////////////////////////////////////////////
+// workers.js
+//
+// node-canal worker_threads example. One CAN channel per worker.
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+
+"use strict";
+
+const { Worker, isMainThread, parentPort, workerData } = require('worker_threads');
+
+const driver = "/home/akhe/development/VSCP/vscpl1drv-socketcan/linux/vscpl1drv-socketcan.so.1.1.0";
+const channels = [ "vcan0", "vcan1", "vcan2", "vcan3" ];
+
+if ( isMainThread ) {
+
+  console.log('workers.js');
+  console.log('==========');
+
+  // Open all channels in parallel, each in its own worker
+  for ( const channel of channels ) {
+    const worker = new Worker(__filename, { workerData: channel });
+    worker.on('message', (msg) => console.log(channel, msg));
+    worker.on('error', (err) => console.log(channel, "error", err));
+    worker.on('exit', (code) => console.log(channel, "exit", code));
+  }
+
+  // Terminating a worker with the channel still open is fine,
+  // the addon stops its threads when the worker goes away
+  setTimeout(() => process.exit(), 10000);
+}
+else {
+
+  // Each worker loads its own instance of the addon
+  const CANAL = require('bindings')('nodecanal');
+  const can = new CANAL.CNodeCanal();
+  let count = 0;
+
+  const callback = (canmsg) => {
+    count++;
+    if ( canmsg.id == 0x999 ) {
+      parentPort.postMessage({ received: count, close: can.close() });
+      process.exit();
+    }
+  };
+
+  let rv = can.init(driver, workerData, 0, callback);
+  if ( CANAL.CANAL_ERROR_SUCCESS != rv ) {
+    parentPort.postMessage({ init: rv });
+    process.exit();
+  }
+
+  parentPort.postMessage({ open: can.open() });
+}
@@ -0,0 +1,331 @@
+///////////////////////////////////////////////////////////////////////////
+// broadcast.cpp
+//
+// Broadcast ring. One receive thread writes each frame once and any
+// number of readers consume it with their own cursor.
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <string.h>
+
+#include <chrono>
+
+#include "broadcast.h"
+
+// Published rings. Process wide on purpose so worker threads can
+// attach to a bus opened in another thread.
+static std::mutex g_registryMutex;
+static std::map<std::string, std::weak_ptr<CBroadcastRing>> g_registry;
+
+///////////////////////////////////////////////////////////////////////////////
+// constructor
+//
+
+CBroadcastRing::CBroadcastRing(size_t capacity)
+{
+    // Round up to a power of two so the slot is seq & mask
+    size_t size = 1;
+    while (size < capacity) {
+        size <<= 1;
+    }
+
+    m_buf.resize(size);
+    m_mask     = size - 1;
+    m_writeSeq = 0;
+    m_nextId   = 1;
+    m_bClosed  = false;
+    m_pif      = NULL;
+    m_bQuit    = false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// deconstructor
+//
+
+CBroadcastRing::~CBroadcastRing()
+{
+    stop();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// start
+//
+
+int
+CBroadcastRing::start(CCanalIf *pif)
+{
+    if (NULL == pif) {
+        return CANAL_ERROR_PARAMETER;
+    }
+
+    if (m_thread.joinable()) {
+        return CANAL_ERROR_INIT_READY;
+    }
+
+    m_pif   = pif;
+    m_bQuit = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_bClosed = false;
+    }
+    m_thread = std::thread(&CBroadcastRing::workThread, this);
+
+    return CANAL_ERROR_SUCCESS;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// stop
+//
+
+void
+CBroadcastRing::stop(void)
+{
+    m_bQuit = true;
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_bClosed = true;
+    }
+    m_cv.notify_all();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// write
+//
+
+void
+CBroadcastRing::write(const canalMsg *pmsg)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        memcpy(&m_buf[m_writeSeq & m_mask], pmsg, sizeof(canalMsg));
+        m_writeSeq++;
+    }
+    m_cv.notify_all();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// addReader
+//
+
+uint32_t
+CBroadcastRing::addReader(uint32_t maxBacklog, int policy)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if ((0 == maxBacklog) || (maxBacklog > m_buf.size())) {
+        maxBacklog = (uint32_t)m_buf.size();
+    }
+
+    uint32_t id              = m_nextId++;
+    broadcastReader &reader  = m_readers[id];
+    reader.cursor            = m_writeSeq;
+    reader.maxBacklog        = maxBacklog;
+    reader.policy            = policy;
+    reader.cntRead           = 0;
+    reader.cntDropped        = 0;
+
+    return id;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// removeReader
+//
+
+bool
+CBroadcastRing::removeReader(uint32_t id)
+{
+    bool rv;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        rv = (0 != m_readers.erase(id));
+    }
+    m_cv.notify_all();
+
+    return rv;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// read
+//
+
+int
+CBroadcastRing::read(uint32_t id, canalMsg *pbuf, size_t max, uint32_t timeout)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    auto it = m_readers.find(id);
+    if (m_readers.end() == it) {
+        return -1;
+    }
+
+    if (timeout && (it->second.cursor == m_writeSeq) && !m_bClosed) {
+        m_cv.wait_for(lock, std::chrono::milliseconds(timeout), [this, id] {
+            auto it = m_readers.find(id);
+            return (m_readers.end() == it) || m_bClosed ||
+                   (it->second.cursor != m_writeSeq);
+        });
+
+        // May have been removed while waiting
+        it = m_readers.find(id);
+        if (m_readers.end() == it) {
+            return -1;
+        }
+    }
+
+    broadcastReader &reader = it->second;
+
+    // Apply drop policy if the reader has fallen behind
+    uint64_t backlog = m_writeSeq - reader.cursor;
+    if (backlog > reader.maxBacklog) {
+        uint64_t skip = (BROADCAST_POLICY_RESYNC == reader.policy) ?
+                            backlog : (backlog - reader.maxBacklog);
+        reader.cursor += skip;
+        reader.cntDropped += skip;
+        backlog -= skip;
+    }
+
+    if (0 == backlog) {
+        return m_bClosed ? -1 : 0;
+    }
+
+    size_t cnt = (backlog < max) ? (size_t)backlog : max;
+    for (size_t i = 0; i < cnt; i++) {
+        memcpy(pbuf + i, &m_buf[(reader.cursor + i) & m_mask], sizeof(canalMsg));
+    }
+
+    reader.cursor += cnt;
+    reader.cntRead += cnt;
+
+    return (int)cnt;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getReaderStatistics
+//
+
+bool
+CBroadcastRing::getReaderStatistics(uint32_t id,
+                                        broadcastReaderStatistics *pstats)
+{
+    if (NULL == pstats) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_readers.find(id);
+    if (m_readers.end() == it) {
+        return false;
+    }
+
+    uint64_t backlog = m_writeSeq - it->second.cursor;
+    if (backlog > it->second.maxBacklog) {
+        backlog = it->second.maxBacklog;
+    }
+
+    pstats->cntRead    = it->second.cntRead;
+    pstats->cntDropped = it->second.cntDropped;
+    pstats->backlog    = (uint32_t)backlog;
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// publish
+//
+
+bool
+CBroadcastRing::publish(const std::string &name,
+                            std::shared_ptr<CBroadcastRing> pring)
+{
+    std::lock_guard<std::mutex> lock(g_registryMutex);
+
+    auto it = g_registry.find(name);
+    if ((g_registry.end() != it) && !it->second.expired()) {
+        return false;
+    }
+
+    g_registry[name] = pring;
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// unpublish
+//
+
+void
+CBroadcastRing::unpublish(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(g_registryMutex);
+    g_registry.erase(name);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// find
+//
+
+std::shared_ptr<CBroadcastRing>
+CBroadcastRing::find(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(g_registryMutex);
+
+    auto it = g_registry.find(name);
+    if (g_registry.end() == it) {
+        return std::shared_ptr<CBroadcastRing>();
+    }
+
+    return it->second.lock();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// workThread
+//
+
+void
+CBroadcastRing::workThread(void)
+{
+    canalMsg msg;
+
+    rtApplyTuning(&m_pif->m_tuning);
+
+    while (!m_bQuit && !m_pif->m_bQuit) {
+
+        // Sit and wait for connection if were not connected
+        if (0 == m_pif->m_openHandle) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+
+        if (CANAL_ERROR_SUCCESS == m_pif->receive(&msg, m_pif->m_config.receiveTimeout)) {
+            write(&msg);
+        }
+    }
+}
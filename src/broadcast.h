@@ -0,0 +1,208 @@
+///////////////////////////////////////////////////////////////////////////
+// broadcast.h
+//
+// Broadcast ring. One receive thread writes each frame once and any
+// number of readers consume it with their own cursor.
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#if !defined(BROADCAST_H)
+#define BROADCAST_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "canalif.h"
+
+// Default number of frames in the ring
+#define BROADCAST_DEFAULT_CAPACITY      4096
+
+// Reader drop policies used when a reader falls behind
+#define BROADCAST_POLICY_DROP_OLDEST    0   // Skip oldest, keep newest maxBacklog
+#define BROADCAST_POLICY_RESYNC         1   // Drop the backlog, go on with new frames
+
+/*!
+    Statistics for a broadcast reader
+*/
+typedef struct structBroadcastReaderStatistics {
+    uint64_t cntRead;                   // # of frames read
+    uint64_t cntDropped;                // # of frames dropped by policy
+    uint32_t backlog;                   // # of frames waiting
+} broadcastReaderStatistics;
+
+/*!
+    Single writer, many readers. The writer never waits for a reader,
+    it overwrites the oldest slot. A reader that lags more than its
+    max backlog (at most the ring capacity) loses frames according
+    to its drop policy. Other readers are not affected.
+
+    Rings can be published under a name so instances in other
+    worker threads can attach readers to the same bus.
+*/
+class CBroadcastRing {
+
+public:
+
+    CBroadcastRing(size_t capacity = BROADCAST_DEFAULT_CAPACITY);
+    ~CBroadcastRing();
+
+    /*!
+        Start the receive thread writing frames from the interface
+
+        @param pif CANAL interface to read from
+        @return CANAL_ERROR_SUCCESS on success
+    */
+    int start(CCanalIf *pif);
+
+    /*!
+        Stop the receive thread and close the ring. Readers get
+        what is left and then end.
+    */
+    void stop(void);
+
+    bool isRunning(void) { return m_thread.joinable(); };
+
+    /*!
+        Write a frame. Never blocks on readers.
+
+        @param pmsg Frame to write
+    */
+    void write(const canalMsg *pmsg);
+
+    /*!
+        Add a reader. It starts at the next written frame.
+
+        @param maxBacklog Max unread frames, zero for ring capacity
+        @param policy BROADCAST_POLICY_xxx
+        @return Reader id
+    */
+    uint32_t addReader(uint32_t maxBacklog, int policy);
+
+    /*!
+        Remove a reader. A read waiting for it returns -1.
+
+        @param id Reader id
+        @return True if the reader was found
+    */
+    bool removeReader(uint32_t id);
+
+    /*!
+        Read frames
+
+        @param id Reader id
+        @param pbuf Buffer receiving the frames
+        @param max Max number of frames to read
+        @param timeout Max time to wait for a frame in milliseconds
+        @return Number of frames read or -1 if the reader is removed
+                    or the ring is closed and there is nothing left.
+    */
+    int read(uint32_t id, canalMsg *pbuf, size_t max, uint32_t timeout);
+
+    /*!
+        Get statistics for a reader
+
+        @param id Reader id
+        @param pstats Pointer to statistics structure to fill in
+        @return True if the reader was found
+    */
+    bool getReaderStatistics(uint32_t id, broadcastReaderStatistics *pstats);
+
+    size_t capacity(void) { return m_buf.size(); };
+
+    /*!
+        Publish a ring under a name
+
+        @param name Name other instances use to attach
+        @param pring Ring to publish
+        @return False if the name is taken by a live ring
+    */
+    static bool publish(const std::string &name,
+                            std::shared_ptr<CBroadcastRing> pring);
+
+    /*!
+        Remove a published name
+
+        @param name Name of ring
+    */
+    static void unpublish(const std::string &name);
+
+    /*!
+        Find a published ring
+
+        @param name Name of ring
+        @return Ring or empty pointer if not found
+    */
+    static std::shared_ptr<CBroadcastRing> find(const std::string &name);
+
+private:
+
+    // Receive thread
+    void workThread(void);
+
+    // A reader
+    typedef struct {
+        uint64_t cursor;                // Sequence number of next frame
+        uint32_t maxBacklog;
+        int policy;
+        uint64_t cntRead;
+        uint64_t cntDropped;
+    } broadcastReader;
+
+    // Protects everything below
+    std::mutex m_mutex;
+
+    // Signaled when a frame is written or the ring is closed
+    std::condition_variable m_cv;
+
+    // Frame storage, size is a power of two
+    std::vector<canalMsg> m_buf;
+    size_t m_mask;
+
+    // Sequence number of next frame to write
+    uint64_t m_writeSeq;
+
+    std::map<uint32_t, broadcastReader> m_readers;
+    uint32_t m_nextId;
+
+    // No more frames will be written
+    bool m_bClosed;
+
+    // Receive thread
+    CCanalIf *m_pif;
+    std::thread m_thread;
+    std::atomic<bool> m_bQuit;
+};
+
+#endif
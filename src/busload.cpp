@@ -0,0 +1,331 @@
+///////////////////////////////////////////////////////////////////////////
+// busload.cpp
+//
+// Bus load estimator. On-wire bit length of each frame summed in
+// sliding windows.
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <string.h>
+
+#include "busload.h"
+
+// Bits after the CRC. CRC delimiter, ack slot, ack delimiter,
+// end of frame and interframe space. Never stuffed.
+#define BUSLOAD_TAIL_BITS       13
+
+///////////////////////////////////////////////////////////////////////////////
+// constructor
+//
+
+CBusLoad::CBusLoad()
+{
+    m_bitrate = 0;
+    m_stuffing = BUSLOAD_STUFF_COMPUTED;
+    m_buckets.resize(BUSLOAD_BUCKETS);
+    clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// deconstructor
+//
+
+CBusLoad::~CBusLoad()
+{
+    ;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// bitrateFromCode
+//
+
+uint32_t
+CBusLoad::bitrateFromCode(uint32_t baudrate)
+{
+    switch (baudrate) {
+        case CANAL_BAUD_USER:
+            return 0;
+        case CANAL_BAUD_1000:
+            return 1000000;
+        case CANAL_BAUD_800:
+            return 800000;
+        case CANAL_BAUD_500:
+            return 500000;
+        case CANAL_BAUD_250:
+            return 250000;
+        case CANAL_BAUD_125:
+            return 125000;
+        case CANAL_BAUD_100:
+            return 100000;
+        case CANAL_BAUD_50:
+            return 50000;
+        case CANAL_BAUD_20:
+            return 20000;
+        case CANAL_BAUD_10:
+            return 10000;
+        default:
+            return baudrate;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// frameBits
+//
+
+uint32_t
+CBusLoad::frameBits(const canalMsg *pmsg, int stuffing)
+{
+    if (pmsg->flags & CANAL_IDFLAG_STATUS) {
+        return 0;
+    }
+
+    bool bExtended = (0 != (pmsg->flags & CANAL_IDFLAG_EXTENDED));
+    bool bRtr = (0 != (pmsg->flags & CANAL_IDFLAG_RTR));
+    uint32_t dlc = (pmsg->sizeData > 8) ? 8 : pmsg->sizeData;
+    uint32_t cntData = bRtr ? 0 : dlc;
+
+    // Start of frame up to and including the CRC
+    uint32_t cntStuffed = (bExtended ? 54 : 34) + 8 * cntData;
+
+    if (BUSLOAD_STUFF_NONE == stuffing) {
+        return cntStuffed + BUSLOAD_TAIL_BITS;
+    }
+
+    if (BUSLOAD_STUFF_WORST == stuffing) {
+        // First stuff bit after five bits then one every four
+        return cntStuffed + (cntStuffed - 1) / 4 + BUSLOAD_TAIL_BITS;
+    }
+
+    // Build the stuffed part of the frame, one bit per byte
+    uint8_t bits[128];
+    uint32_t n = 0;
+
+    auto put = [&bits, &n](uint32_t value, uint32_t cnt) {
+        while (cnt--) {
+            bits[n++] = (value >> cnt) & 1;
+        }
+    };
+
+    put(0, 1);                                      // SOF
+    if (bExtended) {
+        put(pmsg->id >> 18, 11);                    // Base id
+        put(1, 1);                                  // SRR
+        put(1, 1);                                  // IDE
+        put(pmsg->id, 18);                          // Extended id
+        put(bRtr, 1);                               // RTR
+        put(0, 2);                                  // r1, r0
+    }
+    else {
+        put(pmsg->id, 11);                          // Id
+        put(bRtr, 1);                               // RTR
+        put(0, 2);                                  // IDE, r0
+    }
+    put(dlc, 4);
+    for (uint32_t i = 0; i < cntData; i++) {
+        put(pmsg->data[i], 8);
+    }
+
+    // CRC-15 over everything so far
+    uint32_t crc = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t next = bits[i] ^ ((crc >> 14) & 1);
+        crc = (crc << 1) & 0x7fff;
+        if (next) {
+            crc ^= 0x4599;
+        }
+    }
+    put(crc, 15);
+
+    // A stuff bit follows five equal bits and starts a new run
+    uint32_t cntStuff = 0;
+    uint32_t run = 1;
+    uint8_t last = bits[0];
+    for (uint32_t i = 1; i < n; i++) {
+        if (bits[i] == last) {
+            if (5 == ++run) {
+                cntStuff++;
+                last = !last;
+                run = 1;
+            }
+        }
+        else {
+            last = bits[i];
+            run = 1;
+        }
+    }
+
+    return n + cntStuff + BUSLOAD_TAIL_BITS;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// setBitrate
+//
+
+void
+CBusLoad::setBitrate(uint32_t bitrate)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_bitrate = bitrate;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// setStuffing
+//
+
+void
+CBusLoad::setStuffing(int stuffing)
+{
+    m_stuffing = stuffing;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// clear
+//
+
+void
+CBusLoad::clear(void)
+{
+    memset(m_buckets.data(), 0, m_buckets.size() * sizeof(uint32_t));
+    m_start = clock::now();
+    m_current = 0;
+    m_cntFrames = 0;
+    m_cntBits = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// reset
+//
+
+void
+CBusLoad::reset(void)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// advance
+//
+
+void
+CBusLoad::advance(clock::time_point now)
+{
+    uint64_t bucket = std::chrono::duration_cast<std::chrono::milliseconds>(
+                        now - m_start).count() / BUSLOAD_BUCKET_MS;
+    if (bucket <= m_current) {
+        return;
+    }
+
+    // Empty the buckets we passed, at most all of them
+    uint64_t cnt = bucket - m_current;
+    if (cnt > BUSLOAD_BUCKETS) {
+        cnt = BUSLOAD_BUCKETS;
+    }
+    for (uint64_t i = 0; i < cnt; i++) {
+        m_buckets[(bucket - i) % BUSLOAD_BUCKETS] = 0;
+    }
+
+    m_current = bucket;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// add
+//
+
+void
+CBusLoad::add(const canalMsg *pmsg)
+{
+    uint32_t bits = frameBits(pmsg, m_stuffing);
+    if (0 == bits) {
+        return;
+    }
+
+    clock::time_point now = clock::now();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    advance(now);
+    m_buckets[m_current % BUSLOAD_BUCKETS] += bits;
+    m_cntFrames++;
+    m_cntBits += bits;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// load
+//
+
+double
+CBusLoad::load(clock::time_point now, uint32_t cnt)
+{
+    if (0 == m_bitrate) {
+        return 0;
+    }
+
+    // Whole buckets before the current one, never before the start
+    if (cnt > m_current + 1) {
+        cnt = (uint32_t)m_current + 1;
+    }
+
+    uint64_t bits = 0;
+    for (uint32_t i = 0; i < cnt; i++) {
+        bits += m_buckets[(m_current - i) % BUSLOAD_BUCKETS];
+    }
+
+    // The current bucket is only partly over
+    double partUs = (double)std::chrono::duration_cast<std::chrono::microseconds>(
+                        now - m_start).count() -
+                    (double)m_current * BUSLOAD_BUCKET_MS * 1000;
+    double us = (cnt - 1) * BUSLOAD_BUCKET_MS * 1000.0 + partUs;
+    if (us <= 0) {
+        return 0;
+    }
+
+    return 100.0 * bits / ((double)m_bitrate * us / 1000000.0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getLoad
+//
+
+void
+CBusLoad::getLoad(busLoad *pload, bool bReset)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    clock::time_point now = clock::now();
+    advance(now);
+
+    pload->bitrate = m_bitrate;
+    pload->load100ms = load(now, 100 / BUSLOAD_BUCKET_MS);
+    pload->load1s = load(now, 1000 / BUSLOAD_BUCKET_MS);
+    pload->load10s = load(now, BUSLOAD_BUCKETS);
+    pload->cntFrames = m_cntFrames;
+    pload->cntBits = m_cntBits;
+
+    if (bReset) {
+        clear();
+    }
+}
@@ -0,0 +1,166 @@
+///////////////////////////////////////////////////////////////////////////
+// busload.h
+//
+// Bus load estimator. On-wire bit length of each frame summed in
+// sliding windows.
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#if !defined(BUSLOAD_H)
+#define BUSLOAD_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+#include "canal.h"
+
+// How stuff bits are accounted
+#define BUSLOAD_STUFF_COMPUTED  0       // Stuff the actual bit stream
+#define BUSLOAD_STUFF_WORST     1       // Worst case for the length
+#define BUSLOAD_STUFF_NONE      2       // No stuff bits
+
+// Window resolution
+#define BUSLOAD_BUCKET_MS       10
+#define BUSLOAD_BUCKETS         1000    // 10 s
+
+/*!
+    Bus load. Percentages are of the bitrate over the last part
+    of each window.
+*/
+typedef struct structBusLoad {
+    uint32_t bitrate;                   // Bits per second, 0 = unknown
+    double load100ms;                   // Percent last 100 ms
+    double load1s;                      // Percent last second
+    double load10s;                     // Percent last ten seconds
+    uint64_t cntFrames;                 // Frames accounted
+    uint64_t cntBits;                   // Bits accounted
+} busLoad;
+
+/*!
+    Bus load estimator. The on-wire length of each frame is added
+    to 10 ms buckets covering the last ten seconds. Frames can be
+    added from any thread.
+*/
+class CBusLoad {
+
+public:
+
+    typedef std::chrono::steady_clock clock;
+
+    CBusLoad();
+    ~CBusLoad();
+
+    /*!
+        Bits per second for a CANAL_BAUD_* code. Any other value is
+        taken as bits per second.
+
+        @param baudrate CANAL_BAUD_* code or bits per second
+        @return Bits per second, 0 for CANAL_BAUD_USER
+    */
+    static uint32_t bitrateFromCode(uint32_t baudrate);
+
+    /*!
+        On-wire length of a frame from start of frame to the end
+        of the interframe space
+
+        @param pmsg Frame
+        @param stuffing BUSLOAD_STUFF_*
+        @return Length in bits, 0 for status frames
+    */
+    static uint32_t frameBits(const canalMsg *pmsg, int stuffing);
+
+    /*!
+        Set bitrate used for the percentages
+
+        @param bitrate Bits per second
+    */
+    void setBitrate(uint32_t bitrate);
+
+    /*!
+        Set how stuff bits are accounted
+
+        @param stuffing BUSLOAD_STUFF_*
+    */
+    void setStuffing(int stuffing);
+
+    /*!
+        Account a frame seen on the bus
+
+        @param pmsg Frame received or sent
+    */
+    void add(const canalMsg *pmsg);
+
+    /*!
+        Get the load over the windows
+
+        @param pload Receives the load
+        @param bReset True to start over after reading
+    */
+    void getLoad(busLoad *pload, bool bReset = false);
+
+    /*!
+        Start over
+    */
+    void reset(void);
+
+private:
+
+    // Move the current bucket up to now. Lock must be held.
+    void advance(clock::time_point now);
+
+    // Percent over the last cnt buckets. Lock must be held.
+    double load(clock::time_point now, uint32_t cnt);
+
+    // Forget everything. Lock must be held.
+    void clear(void);
+
+    // Protects everything below
+    std::mutex m_mutex;
+
+    uint32_t m_bitrate;
+
+    // Read without the lock by add
+    std::atomic<int> m_stuffing;
+
+    // Bits per bucket, ring indexed by bucket number
+    std::vector<uint32_t> m_buckets;
+
+    // Bucket zero starts here
+    clock::time_point m_start;
+
+    // Bucket number of the current bucket
+    uint64_t m_current;
+
+    uint64_t m_cntFrames;
+    uint64_t m_cntBits;
+};
+
+#endif
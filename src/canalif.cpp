@@ -37,6 +37,7 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <syslog.h>
+#include <time.h>
 #include <unistd.h>
 #include <dlfcn.h>
 
@@ -48,9 +49,15 @@
 #include "canal_macro.h"
 #include "canaldlldef.h"
 #include "canalif.h"
+#include "coalesce.h"
+#include "framering.h"
+#include "jsonvalue.h"
+
+#include <chrono>
 
 void *deviceReceiveThread(void *pData);
 void *deviceWriteThread(void *pData);
+void *deviceRecoverThread(void *pData);
 
 ///////////////////////////////////////////////////////////////////////////////
 // constructor
@@ -61,6 +68,30 @@ CCanalIf::CCanalIf()
     // Open syslog
     openlog("node-canal", LOG_CONS, LOG_LOCAL0);
 
+    rtInitTuning(&m_tuning);
+    initConfig(&m_config);
+    m_bWriteThread = false;
+    m_bRecoverThread = false;
+    m_proc_CanalSetBaudrate = NULL;
+
+    m_recoverState = RECOVER_STATE_OK;
+    m_cntDriverErrors = 0;
+    m_lastDriverError = CANAL_ERROR_SUCCESS;
+    m_cntRecoveries = 0;
+    m_cntTxExpired = 0;
+    m_cntTxSent = 0;
+    m_cntTxThrottled = 0;
+    m_txThrottledUs = 0;
+    m_cntTxRetries = 0;
+    m_cntTxErrors = 0;
+    pthread_mutex_init(&m_mutexRecovery, NULL);
+
+    m_spinUs = 0;
+    m_bIdStatistics = false;
+    m_bBusLoad = false;
+    pthread_mutex_init(&m_mutexReceiveStatistics, NULL);
+    resetReceiveStatistics();
+
     if (-1 == sem_init(&m_semClientOutputQueue, 0, 0)) {
         syslog(LOG_ERR, "Unable to init m_semClientOutputQueue");
         return;
@@ -71,6 +102,11 @@ CCanalIf::CCanalIf()
         return;
     }
 
+    if (-1 == sem_init(&m_semRecover, 0, 0)) {
+        syslog(LOG_ERR, "Unable to init m_semRecover");
+        return;
+    }
+
     if (0 != pthread_mutex_init(&m_mutexClientOutputQueue, NULL)) {
         syslog(LOG_ERR, "Unable to init m_mutexClientOutputQueue");
         return;
@@ -91,6 +127,13 @@ CCanalIf::CCanalIf()
 
 CCanalIf::~CCanalIf()
 {
+    pthread_mutex_destroy(&m_mutexReceiveStatistics);
+    pthread_mutex_destroy(&m_mutexRecovery);
+
+    if (0 != sem_destroy(&m_semRecover)) {
+        syslog(LOG_ERR, "Unable to destroy m_semRecover");
+    }
+
     if (0 != sem_destroy(&m_semClientOutputQueue)) {
         syslog(LOG_ERR, "Unable to destroy m_semClientOutputQueue");
     }
@@ -132,6 +175,11 @@ CCanalIf::init(std::string strpath,
     m_strParameter = strparam;
     m_deviceFlags  = flags;
 
+    m_config.path   = strpath;
+    m_config.config = strparam;
+    m_config.flags  = flags;
+    m_config.bAsync = bAsync;
+
     // Load dynamic library
     m_hdll = dlopen(strpath.c_str(), RTLD_LAZY);
     if (!m_hdll) {
@@ -269,6 +317,18 @@ CCanalIf::init(std::string strpath,
         return CANAL_ERROR_LIBRARY;
     }
 
+    // * * * * CANAL SET BAUDRATE * * * *
+    m_proc_CanalSetBaudrate =
+      (LPFNDLL_CANALSETBAUDRATE)dlsym(m_hdll, "CanalSetBaudrate");
+    dlsym_error = dlerror();
+    if (dlsym_error) {
+        syslog(LOG_ERR,
+               "%s: Unable to get dl entry for CanalSetBaudrate. Baudrate "
+               "can not be set.",
+               m_strPath.c_str());
+        m_proc_CanalSetBaudrate = NULL;
+    }
+
     // * * * * CANAL GET VERSION * * * *
     m_proc_CanalGetVersion =
       (LPFNDLL_CANALGETVERSION)dlsym(m_hdll, "CanalGetVersion");
@@ -351,6 +411,382 @@ CCanalIf::init(std::string strpath,
     return CANAL_ERROR_SUCCESS;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// init
+//
+
+int
+CCanalIf::init(std::string jsonInit)
+{
+    canalConfig cfg;
+
+    initConfig(&cfg);
+    int rv = parseConfig(jsonInit, &cfg, m_strError);
+    if (CANAL_ERROR_SUCCESS != rv) {
+        return rv;
+    }
+
+    return init(&cfg);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// init
+//
+
+int
+CCanalIf::init(const canalConfig *pcfg)
+{
+    if (NULL == pcfg) {
+        m_strError = "No init data";
+        return CANAL_ERROR_PARAMETER;
+    }
+
+    if (pcfg->path.empty()) {
+        m_strError = "path is required";
+        return CANAL_ERROR_PARAMETER;
+    }
+
+    // Tell right away if the process isn't allowed to do this
+    int rv = rtCheckTuning(&pcfg->tuning, m_strError);
+    if (CANAL_ERROR_SUCCESS != rv) {
+        return rv;
+    }
+
+    m_strError.clear();
+    m_config = *pcfg;
+    m_tuning = pcfg->tuning;
+    m_spinUs = pcfg->spinUs;
+
+    return init(pcfg->path, pcfg->config, pcfg->flags, pcfg->bAsync);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// initConfig
+//
+
+void
+CCanalIf::initConfig(canalConfig *pcfg)
+{
+    if (NULL == pcfg) {
+        return;
+    }
+
+    pcfg->path.clear();
+    pcfg->config.clear();
+    pcfg->flags             = 0;
+    pcfg->bAsync            = false;
+    pcfg->receiveTimeout    = CANALIF_DEFAULT_RECEIVE_TIMEOUT;
+    pcfg->spinUs            = 0;
+    pcfg->txQueueSize       = MAX_CAN_MESSAGES;
+    pcfg->txOrder           = TXQUEUE_ORDER_FIFO;
+    pcfg->streamCapacity    = FRAMERING_DEFAULT_CAPACITY;
+    pcfg->broadcastCapacity = FRAMERING_DEFAULT_CAPACITY;
+    pcfg->batchSize         = CANALIF_DEFAULT_BATCH_SIZE;
+    pcfg->deliveryMaxFrames = COALESCE_LOW_LATENCY_FRAMES;
+    pcfg->deliveryMaxHoldUs = COALESCE_LOW_LATENCY_HOLD_US;
+    pcfg->bColumnar         = false;
+    pcfg->bFilter           = false;
+    pcfg->filter            = 0;
+    pcfg->bMask             = false;
+    pcfg->mask              = 0;
+    pcfg->bBaudrate         = false;
+    pcfg->baudrate          = 0;
+    pcfg->bRecover          = false;
+    pcfg->recoverErrors     = CANALIF_DEFAULT_RECOVER_ERRORS;
+    pcfg->recoverMinBackoffMs = CANALIF_DEFAULT_RECOVER_MIN_MS;
+    pcfg->recoverMaxBackoffMs = CANALIF_DEFAULT_RECOVER_MAX_MS;
+    pcfg->txMaxAgeMs        = 0;
+    memset(&pcfg->txRate, 0, sizeof(shaperRate));
+    pcfg->txRate.burstFrames = SHAPER_DEFAULT_BURST_FRAMES;
+    pcfg->txRate.burstBits  = SHAPER_DEFAULT_BURST_BITS;
+    pcfg->txRetryMinUs      = CANALIF_DEFAULT_TX_RETRY_MIN_US;
+    pcfg->txRetryMaxUs      = CANALIF_DEFAULT_TX_RETRY_MAX_US;
+    rtInitTuning(&pcfg->tuning);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getUint
+//
+// Read an optional unsigned member. Returns false if it is there
+// but isn't a non negative number.
+//
+
+static bool
+getUint(const CJsonValue &obj,
+            const char *key,
+            uint32_t &value,
+            std::string &strError)
+{
+    if (!obj.has(key)) {
+        return true;
+    }
+
+    const CJsonValue &val = obj.get(key);
+    if (!val.isNumber() || (val.getNumber() < 0) ||
+        (val.getNumber() > 0xffffffff)) {
+        strError = std::string(key) + " should be a positive number";
+        return false;
+    }
+
+    value = (uint32_t)val.getNumber();
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// parseConfig
+//
+
+int
+CCanalIf::parseConfig(const std::string &jsonInit,
+                        canalConfig *pcfg,
+                        std::string &strError)
+{
+    CJsonValue json;
+
+    if (NULL == pcfg) {
+        strError = "No init data";
+        return CANAL_ERROR_PARAMETER;
+    }
+
+    if (!json.parse(jsonInit, strError)) {
+        return CANAL_ERROR_PARAMETER;
+    }
+
+    if (!json.isObject()) {
+        strError = "Init data should be a JSON object";
+        return CANAL_ERROR_PARAMETER;
+    }
+
+    // Strings
+    static const char *strings[] = { "path", "config", "schedPolicy", "txOrder" };
+    for (const char *key : strings) {
+        if (json.has(key) && !json.get(key).isString()) {
+            strError = std::string(key) + " should be a string";
+            return CANAL_ERROR_PARAMETER;
+        }
+    }
+
+    if (json.has("path")) {
+        pcfg->path = json.get("path").getString();
+    }
+
+    if (json.has("config")) {
+        pcfg->config = json.get("config").getString();
+    }
+
+    // Booleans
+    static const char *bools[] = { "bAsync", "lockMemory" };
+    for (const char *key : bools) {
+        if (json.has(key) && !json.get(key).isBool()) {
+            strError = std::string(key) + " should be true or false";
+            return CANAL_ERROR_PARAMETER;
+        }
+    }
+
+    if (json.has("bAsync")) {
+        pcfg->bAsync = json.get("bAsync").getBool();
+    }
+
+    if (json.has("lockMemory")) {
+        pcfg->tuning.bLockMemory = json.get("lockMemory").getBool();
+    }
+
+    // Numbers
+    uint32_t prefaultStackKb = pcfg->tuning.prefaultStack / 1024;
+    uint32_t priority = (uint32_t)pcfg->tuning.priority;
+    if (!getUint(json, "flags", pcfg->flags, strError) ||
+        !getUint(json, "receiveTimeout", pcfg->receiveTimeout, strError) ||
+        !getUint(json, "spinUs", pcfg->spinUs, strError) ||
+        !getUint(json, "txQueueSize", pcfg->txQueueSize, strError) ||
+        !getUint(json, "streamCapacity", pcfg->streamCapacity, strError) ||
+        !getUint(json, "broadcastCapacity", pcfg->broadcastCapacity, strError) ||
+        !getUint(json, "batchSize", pcfg->batchSize, strError) ||
+        !getUint(json, "filter", pcfg->filter, strError) ||
+        !getUint(json, "mask", pcfg->mask, strError) ||
+        !getUint(json, "baudrate", pcfg->baudrate, strError) ||
+        !getUint(json, "txMaxAgeMs", pcfg->txMaxAgeMs, strError) ||
+        !getUint(json, "schedPriority", priority, strError) ||
+        !getUint(json, "prefaultStackKb", prefaultStackKb, strError)) {
+        return CANAL_ERROR_PARAMETER;
+    }
+
+    // Zero means forever for the blocking receive
+    if (0 == pcfg->receiveTimeout) {
+        strError = "receiveTimeout should be at least one millisecond";
+        return CANAL_ERROR_PARAMETER;
+    }
+
+    if (0 == pcfg->txQueueSize) {
+        pcfg->txQueueSize = 1;
+    }
+
+    if (0 == pcfg->batchSize) {
+        pcfg->batchSize = 1;
+    }
+
+    pcfg->bFilter = pcfg->bFilter || json.has("filter");
+    pcfg->bMask   = pcfg->bMask || json.has("mask");
+    pcfg->bBaudrate = pcfg->bBaudrate || json.has("baudrate");
+    pcfg->tuning.priority      = (int32_t)priority;
+    pcfg->tuning.prefaultStack = 1024 * prefaultStackKb;
+
+    // Listener delivery policy
+    if (json.has("delivery")) {
+        const CJsonValue &delivery = json.get("delivery");
+        if (delivery.isString() && ("lowLatency" == delivery.getString())) {
+            pcfg->deliveryMaxFrames = COALESCE_LOW_LATENCY_FRAMES;
+            pcfg->deliveryMaxHoldUs = COALESCE_LOW_LATENCY_HOLD_US;
+        }
+        else if (delivery.isString() && ("highThroughput" == delivery.getString())) {
+            pcfg->deliveryMaxFrames = COALESCE_HIGH_THROUGHPUT_FRAMES;
+            pcfg->deliveryMaxHoldUs = COALESCE_HIGH_THROUGHPUT_HOLD_US;
+        }
+        else if (delivery.isObject()) {
+            pcfg->deliveryMaxFrames = COALESCE_LOW_LATENCY_FRAMES;
+            pcfg->deliveryMaxHoldUs = COALESCE_LOW_LATENCY_HOLD_US;
+            if (!getUint(delivery, "maxFrames", pcfg->deliveryMaxFrames, strError) ||
+                !getUint(delivery, "maxHoldUs", pcfg->deliveryMaxHoldUs, strError)) {
+                return CANAL_ERROR_PARAMETER;
+            }
+        }
+        else {
+            strError = "delivery should be \"lowLatency\", \"highThroughput\" "
+                       "or {maxFrames, maxHoldUs}";
+            return CANAL_ERROR_PARAMETER;
+        }
+    }
+
+    if (json.has("txOrder")) {
+        std::string order = json.get("txOrder").getString();
+        if ("fifo" == order) {
+            pcfg->txOrder = TXQUEUE_ORDER_FIFO;
+        }
+        else if ("id" == order) {
+            pcfg->txOrder = TXQUEUE_ORDER_ID;
+        }
+        else {
+            strError = "txOrder should be \"fifo\" or \"id\"";
+            return CANAL_ERROR_PARAMETER;
+        }
+    }
+
+    // Reopen on driver failure
+    if (json.has("recover")) {
+        const CJsonValue &recover = json.get("recover");
+        if (recover.isBool()) {
+            pcfg->bRecover = recover.getBool();
+        }
+        else if (recover.isObject()) {
+            pcfg->bRecover = true;
+            if (!getUint(recover, "errors", pcfg->recoverErrors, strError) ||
+                !getUint(recover, "minBackoffMs", pcfg->recoverMinBackoffMs, strError) ||
+                !getUint(recover, "maxBackoffMs", pcfg->recoverMaxBackoffMs, strError)) {
+                return CANAL_ERROR_PARAMETER;
+            }
+        }
+        else {
+            strError = "recover should be true, false or "
+                       "{errors, minBackoffMs, maxBackoffMs}";
+            return CANAL_ERROR_PARAMETER;
+        }
+
+        if (0 == pcfg->recoverErrors) {
+            pcfg->recoverErrors = 1;
+        }
+        if (0 == pcfg->recoverMinBackoffMs) {
+            pcfg->recoverMinBackoffMs = 1;
+        }
+        if (pcfg->recoverMaxBackoffMs < pcfg->recoverMinBackoffMs) {
+            pcfg->recoverMaxBackoffMs = pcfg->recoverMinBackoffMs;
+        }
+    }
+
+    // Async send rate limits
+    if (json.has("txRate")) {
+        const CJsonValue &rate = json.get("txRate");
+        if (!rate.isObject()) {
+            strError = "txRate should be {framesPerSec, bitsPerSec, "
+                       "burstFrames, burstBits}";
+            return CANAL_ERROR_PARAMETER;
+        }
+        if (!getUint(rate, "framesPerSec", pcfg->txRate.framesPerSec, strError) ||
+            !getUint(rate, "bitsPerSec", pcfg->txRate.bitsPerSec, strError) ||
+            !getUint(rate, "burstFrames", pcfg->txRate.burstFrames, strError) ||
+            !getUint(rate, "burstBits", pcfg->txRate.burstBits, strError)) {
+            return CANAL_ERROR_PARAMETER;
+        }
+    }
+
+    // Retry of sends the driver had no room for
+    if (json.has("txRetry")) {
+        const CJsonValue &retry = json.get("txRetry");
+        if (!retry.isObject()) {
+            strError = "txRetry should be {minUs, maxUs}";
+            return CANAL_ERROR_PARAMETER;
+        }
+        if (!getUint(retry, "minUs", pcfg->txRetryMinUs, strError) ||
+            !getUint(retry, "maxUs", pcfg->txRetryMaxUs, strError)) {
+            return CANAL_ERROR_PARAMETER;
+        }
+        if (0 == pcfg->txRetryMinUs) {
+            pcfg->txRetryMinUs = 1;
+        }
+        if (pcfg->txRetryMaxUs < pcfg->txRetryMinUs) {
+            pcfg->txRetryMaxUs = pcfg->txRetryMinUs;
+        }
+    }
+
+    if (json.has("deliveryFormat")) {
+        const CJsonValue &format = json.get("deliveryFormat");
+        if (format.isString() && ("objects" == format.getString())) {
+            pcfg->bColumnar = false;
+        }
+        else if (format.isString() && ("columnar" == format.getString())) {
+            pcfg->bColumnar = true;
+        }
+        else {
+            strError = "deliveryFormat should be \"objects\" or \"columnar\"";
+            return CANAL_ERROR_PARAMETER;
+        }
+    }
+
+    // Scheduling
+    if (json.has("schedPolicy")) {
+        std::string policy = json.get("schedPolicy").getString();
+        if ("fifo" == policy) {
+            pcfg->tuning.policy = SCHED_FIFO;
+        }
+        else if ("rr" == policy) {
+            pcfg->tuning.policy = SCHED_RR;
+        }
+        else if ("other" == policy) {
+            pcfg->tuning.policy = SCHED_OTHER;
+        }
+        else {
+            strError = "schedPolicy should be \"fifo\", \"rr\" or \"other\"";
+            return CANAL_ERROR_PARAMETER;
+        }
+    }
+
+    if (json.has("cpus")) {
+        const CJsonValue &cpus = json.get("cpus");
+        if (!cpus.isArray()) {
+            strError = "cpus should be an array of CPU numbers";
+            return CANAL_ERROR_PARAMETER;
+        }
+        pcfg->tuning.cpus.clear();
+        for (size_t i = 0; i < cpus.size(); i++) {
+            if (!cpus.at(i).isNumber()) {
+                strError = "cpus should be an array of CPU numbers";
+                return CANAL_ERROR_PARAMETER;
+            }
+            pcfg->tuning.cpus.push_back((int)cpus.at(i).getNumber());
+        }
+    }
+
+    return CANAL_ERROR_SUCCESS;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // CanalOpen
 //
@@ -359,33 +795,101 @@ int
 CCanalIf::CanalOpen()
 {
     // Must NOT be open
-    if (0 != m_openHandle) {
+    if ((0 != m_openHandle) || m_bRecoverThread) {
         return CANAL_ERROR_NOT_OPEN;
     }
 
     // Open the device
-    m_openHandle =
+    long handle =
       m_proc_CanalOpen((const char *)m_strParameter.c_str(), m_deviceFlags);
-    syslog(LOG_INFO, "openhandle :%ld", m_openHandle);
+    syslog(LOG_INFO, "openhandle :%ld", handle);
 
     // Check if the driver opened properly
-    if (m_openHandle <= 0) {
+    if (handle <= 0) {
+        m_openHandle = 0;
         syslog(LOG_ERR,
                "Failed to open driver. Will not use it! %ld [%s] ",
-               m_openHandle,
+               handle,
                m_strPath.c_str());
         dlclose(m_hdll);
         return CANAL_ERROR_NOT_OPEN;
     }
 
     // Get Driver Level
-    m_driverLevel = m_proc_CanalGetLevel(m_openHandle);
+    m_driverLevel = m_proc_CanalGetLevel(handle);
+
+    applyConfig(handle);
+
+    m_cntDriverErrors = 0;
+    m_recoverState = RECOVER_STATE_OK;
+    m_openHandle = handle;
 
     //pthread_create(&(m_wrkthread), NULL, &deviceReceiveThread, this );
 
+    // Sends are queued and written from a thread of their own
+    if (m_config.bAsync) {
+        pthread_mutex_lock(&m_mutexClientInputQueue);
+        m_clientInputQueue.setCapacity(m_config.txQueueSize);
+        m_clientInputQueue.setOrder(m_config.txOrder);
+        pthread_mutex_unlock(&m_mutexClientInputQueue);
+        m_txShaper.setRate(&m_config.txRate);
+
+        m_bQuit = false;
+        if (0 == pthread_create(&m_writeThread, NULL, &deviceWriteThread, this)) {
+            m_bWriteThread = true;
+        }
+        else {
+            syslog(LOG_ERR, "Unable to start send thread, sends are synchronous");
+        }
+    }
+
+    // Reopens the driver if it fails
+    if (m_config.bRecover) {
+        m_bQuit = false;
+        if (0 == pthread_create(&m_recoverThread, NULL, &deviceRecoverThread, this)) {
+            m_bRecoverThread = true;
+        }
+        else {
+            syslog(LOG_ERR, "Unable to start recovery thread");
+        }
+    }
+
     return CANAL_ERROR_SUCCESS;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// applyConfig
+//
+
+void
+CCanalIf::applyConfig(long handle)
+{
+    if (m_config.bFilter &&
+        (CANAL_ERROR_SUCCESS != m_proc_CanalSetFilter(handle, m_config.filter))) {
+        syslog(LOG_ERR, "Failed to set filter %08X", m_config.filter);
+    }
+
+    if (m_config.bMask &&
+        (CANAL_ERROR_SUCCESS != m_proc_CanalSetMask(handle, m_config.mask))) {
+        syslog(LOG_ERR, "Failed to set mask %08X", m_config.mask);
+    }
+
+    if (m_config.bBaudrate) {
+        if (NULL == m_proc_CanalSetBaudrate) {
+            syslog(LOG_ERR, "Driver can not set baudrate %u", m_config.baudrate);
+        }
+        else if (CANAL_ERROR_SUCCESS != m_proc_CanalSetBaudrate(handle, m_config.baudrate)) {
+            syslog(LOG_ERR, "Failed to set baudrate %u", m_config.baudrate);
+        }
+        else {
+            uint32_t bitrate = CBusLoad::bitrateFromCode(m_config.baudrate);
+            if (bitrate) {
+                m_busLoad.setBitrate(bitrate);
+            }
+        }
+    }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // CanalClose
 //
@@ -393,16 +897,46 @@ CCanalIf::CanalOpen()
 int
 CCanalIf::CanalClose()
 {
-    // Must be open
-    if (0 == m_openHandle) {
+    // Must be open or being reopened
+    if ((0 == m_openHandle) && !m_bRecoverThread) {
         return CANAL_ERROR_NOT_OPEN;
     }
 
     m_bQuit = true;
-    //usleep(500); // Give driver some time to write out pending data
-    int rv = m_proc_CanalClose(m_openHandle);
-    if (CANAL_ERROR_SUCCESS != rv) {
-        return rv;
+
+    // Stop reopening before the handle goes
+    if (m_bRecoverThread) {
+        sem_post(&m_semRecover);
+        pthread_join(m_recoverThread, NULL);
+        m_bRecoverThread = false;
+
+        while (0 == sem_trywait(&m_semRecover)) {
+            ;
+        }
+    }
+
+    // Stop the send thread and drop what it did not get out
+    if (m_bWriteThread) {
+        sem_post(&m_semClientInputQueue);
+        pthread_join(m_writeThread, NULL);
+        m_bWriteThread = false;
+
+        pthread_mutex_lock(&m_mutexClientInputQueue);
+        m_clientInputQueue.clear();
+        pthread_mutex_unlock(&m_mutexClientInputQueue);
+
+        while (0 == sem_trywait(&m_semClientInputQueue)) {
+            ;
+        }
+    }
+
+    // Recovery may have given up with the driver closed
+    if (m_openHandle) {
+        //usleep(500); // Give driver some time to write out pending data
+        int rv = m_proc_CanalClose(m_openHandle);
+        if (CANAL_ERROR_SUCCESS != rv) {
+            return rv;
+        }
     }
 
     m_openHandle = 0;
@@ -417,22 +951,43 @@ CCanalIf::CanalClose()
 //
 
 int
-CCanalIf::CanalSend(canalMsg* pcanmsg)
+CCanalIf::CanalSend(canalMsg* pcanmsg, uint8_t priority)
 {
     // Check pointer
     if ( NULL == pcanmsg ) {
         return CANAL_ERROR_PARAMETER;
     }
 
-    // Must be open
-    if (0 == m_openHandle) {
+    // Must be open. Queued sends are kept while being reopened.
+    if ((0 == m_openHandle) && !(m_bWriteThread && m_bRecoverThread)) {
         return CANAL_ERROR_NOT_OPEN;
     }
 
+    // Queue for the send thread
+    if (m_bWriteThread) {
+
+        pthread_mutex_lock(&m_mutexClientInputQueue);
+        bool bQueued = m_clientInputQueue.push(pcanmsg, priority);
+        pthread_mutex_unlock(&m_mutexClientInputQueue);
+
+        if (!bQueued) {
+            return CANAL_ERROR_FIFO_FULL;
+        }
+
+        sem_post(&m_semClientInputQueue);
+        return CANAL_ERROR_SUCCESS;
+    }
+
     int rv = m_proc_CanalSend(m_openHandle, pcanmsg);
+    noteResult(rv);
     if (CANAL_ERROR_SUCCESS != rv) {
         return rv;
     }
+
+    if (m_bBusLoad) {
+        m_busLoad.add(pcanmsg);
+    }
+
     return CANAL_ERROR_SUCCESS;
 }
 
@@ -459,10 +1014,15 @@ CCanalIf::CanalBlockingSend(canalMsg* pcanmsg, uint32_t timeout)
     }
 
     int rv = m_proc_CanalBlockingSend(m_openHandle, pcanmsg, timeout);
+    noteResult(rv);
     if (CANAL_ERROR_SUCCESS != rv) {
         return rv;
     }
 
+    if (m_bBusLoad) {
+        m_busLoad.add(pcanmsg);
+    }
+
     return CANAL_ERROR_SUCCESS;
 }
 
@@ -484,10 +1044,15 @@ CCanalIf::CanalReceive(canalMsg* pcanmsg)
     }
 
     int rv = m_proc_CanalReceive(m_openHandle, pcanmsg);
+    noteResult(rv);
     if (CANAL_ERROR_SUCCESS != rv) {
         return rv;
     }
 
+    if (m_bBusLoad) {
+        m_busLoad.add(pcanmsg);
+    }
+
     return CANAL_ERROR_SUCCESS;
 }
 
@@ -498,15 +1063,32 @@ CCanalIf::CanalReceive(canalMsg* pcanmsg)
 int
 CCanalIf::CanalBlockingReceive(canalMsg* pcanmsg, uint32_t timeout)
 {
-    canalMsg CanMsg;
+    // Check pointer
+    if ( NULL == pcanmsg ) {
+        return CANAL_ERROR_PARAMETER;
+    }
+
+    // Check if generation 2
+    if (NULL == m_proc_CanalBlockingReceive) {
+        return CANAL_ERROR_LIBRARY;
+    }
 
     // Must be open
     if (0 == m_openHandle) {
         return CANAL_ERROR_NOT_OPEN;
     }
 
-    return m_proc_CanalBlockingReceive(m_openHandle, &CanMsg, timeout);
+    int rv = m_proc_CanalBlockingReceive(m_openHandle, pcanmsg, timeout);
+    noteResult(rv);
+    if (CANAL_ERROR_SUCCESS != rv) {
+        return rv;
+    }
 
+    if (m_bBusLoad) {
+        m_busLoad.add(pcanmsg);
+    }
+
+    return CANAL_ERROR_SUCCESS;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -520,6 +1102,146 @@ CCanalIf::CanalDataAvailable()
     return rv;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// cpuRelax
+//
+// Hint to the CPU that we are spinning
+//
+
+static inline void
+cpuRelax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// receive
+//
+
+int
+CCanalIf::receive(canalMsg *pcanmsg, uint32_t timeout)
+{
+    typedef std::chrono::steady_clock clock;
+    int rv;
+    bool bSpin = false;
+
+    uint32_t spinUs = m_spinUs;
+    if (spinUs && m_openHandle) {
+
+        clock::time_point start = clock::now();
+        clock::time_point deadline = start + std::chrono::microseconds(spinUs);
+        clock::time_point now;
+
+        rv = CANAL_ERROR_FIFO_EMPTY;
+        do {
+            if ((m_proc_CanalDataAvailable(m_openHandle) > 0) &&
+                (CANAL_ERROR_SUCCESS == (rv = CanalReceive(pcanmsg)))) {
+                break;
+            }
+            cpuRelax();
+            now = clock::now();
+        } while ((now < deadline) && !m_bQuit);
+
+        now = clock::now();
+        uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(now - start).count();
+
+        pthread_mutex_lock(&m_mutexReceiveStatistics);
+        m_receiveStatistics.spinUs += us;
+        if (CANAL_ERROR_SUCCESS == rv) {
+            m_receiveStatistics.cntSpinFrames++;
+        }
+        else {
+            m_receiveStatistics.cntSpinMisses++;
+        }
+        pthread_mutex_unlock(&m_mutexReceiveStatistics);
+
+        bSpin = (CANAL_ERROR_SUCCESS == rv);
+    }
+
+    if (!bSpin) {
+        rv = CanalBlockingReceive(pcanmsg, timeout);
+        if (CANAL_ERROR_SUCCESS != rv) {
+            return rv;
+        }
+    }
+
+    if (m_bIdStatistics) {
+        m_idStatistics.add(pcanmsg);
+    }
+
+    // Offset between our clock and the driver timestamp. The lowest
+    // offset seen is taken as zero latency.
+    uint32_t nowUs = (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+                        clock::now().time_since_epoch()).count();
+    uint32_t offset = nowUs - pcanmsg->timestamp;
+
+    pthread_mutex_lock(&m_mutexReceiveStatistics);
+
+    if (!bSpin) {
+        m_receiveStatistics.cntBlockingFrames++;
+    }
+
+    if (!m_bLatencyRef) {
+        m_bLatencyRef = true;
+        m_latencyRef = offset;
+        m_minLatency = 0;
+    }
+
+    int32_t rel = (int32_t)(offset - m_latencyRef);
+    if (rel < m_minLatency) {
+        m_minLatency = rel;
+    }
+
+    uint32_t latency = (uint32_t)(rel - m_minLatency);
+    if (latency > m_receiveStatistics.maxLatencyUs) {
+        m_receiveStatistics.maxLatencyUs = latency;
+    }
+    m_sumLatencyUs += latency;
+    m_cntLatency++;
+
+    pthread_mutex_unlock(&m_mutexReceiveStatistics);
+
+    return CANAL_ERROR_SUCCESS;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getReceiveStatistics
+//
+
+void
+CCanalIf::getReceiveStatistics(receiveStatistics *pstats)
+{
+    if (NULL == pstats) {
+        return;
+    }
+
+    pthread_mutex_lock(&m_mutexReceiveStatistics);
+    *pstats = m_receiveStatistics;
+    pstats->avgLatencyUs = m_cntLatency ? (m_sumLatencyUs / m_cntLatency) : 0;
+    pthread_mutex_unlock(&m_mutexReceiveStatistics);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// resetReceiveStatistics
+//
+
+void
+CCanalIf::resetReceiveStatistics(void)
+{
+    pthread_mutex_lock(&m_mutexReceiveStatistics);
+    memset(&m_receiveStatistics, 0, sizeof(receiveStatistics));
+    m_cntLatency   = 0;
+    m_sumLatencyUs = 0;
+    m_bLatencyRef  = false;
+    m_latencyRef   = 0;
+    m_minLatency   = 0;
+    pthread_mutex_unlock(&m_mutexReceiveStatistics);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // CanalGetStatus
 //
@@ -586,6 +1308,10 @@ CCanalIf::CanalSetFilter(uint32_t filter)
     if (CANAL_ERROR_SUCCESS != rv) {
         return rv;
     }
+
+    // Set again if the driver is reopened
+    m_config.bFilter = true;
+    m_config.filter = filter;
     return CANAL_ERROR_SUCCESS;
 }
 
@@ -605,6 +1331,10 @@ CCanalIf::CanalSetMask(uint32_t mask)
     if (CANAL_ERROR_SUCCESS != rv) {
         return rv;
     }
+
+    // Set again if the driver is reopened
+    m_config.bMask = true;
+    m_config.mask = mask;
     return CANAL_ERROR_SUCCESS;
 }
 
@@ -620,10 +1350,25 @@ CCanalIf::CanalSetBaudrate(uint32_t baudrate)
         return CANAL_ERROR_NOT_OPEN;
     }
 
+    // Not all drivers export it
+    if (NULL == m_proc_CanalSetBaudrate) {
+        return CANAL_ERROR_NOT_SUPPORTED;
+    }
+
     int rv = m_proc_CanalSetBaudrate(m_openHandle, baudrate);
     if (CANAL_ERROR_SUCCESS != rv) {
         return rv;
     }
+
+    // Set again if the driver is reopened
+    m_config.bBaudrate = true;
+    m_config.baudrate = baudrate;
+
+    // Keep the bus load in step with the bus
+    uint32_t bitrate = CBusLoad::bitrateFromCode(baudrate);
+    if (bitrate) {
+        m_busLoad.setBitrate(bitrate);
+    }
     return CANAL_ERROR_SUCCESS;
 }
 
@@ -688,6 +1433,226 @@ CCanalIf::CanalGetDriverInfo(void)
 }
 
 
+///////////////////////////////////////////////////////////////////////////////
+// absTimeout
+//
+// Absolute CLOCK_REALTIME deadline ms from now for sem_timedwait
+//
+
+static void
+absTimeout(struct timespec *pts, uint32_t ms)
+{
+    clock_gettime(CLOCK_REALTIME, pts);
+    pts->tv_nsec += 1000000L * (ms % 1000);
+    pts->tv_sec += ms / 1000 + pts->tv_nsec / 1000000000L;
+    pts->tv_nsec %= 1000000000L;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// setRecoveryCallback
+//
+
+void
+CCanalIf::setRecoveryCallback(std::function<void(const recoveryEvent *)> callback)
+{
+    pthread_mutex_lock(&m_mutexRecovery);
+    m_recoveryCallback = callback;
+    pthread_mutex_unlock(&m_mutexRecovery);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// notifyRecovery
+//
+
+void
+CCanalIf::notifyRecovery(recoveryEvent *pev)
+{
+    m_recoverState = pev->state;
+    pev->cntRecoveries = m_cntRecoveries;
+    pev->cntTxExpired = m_cntTxExpired;
+
+    pthread_mutex_lock(&m_mutexRecovery);
+    if (m_recoveryCallback) {
+        m_recoveryCallback(pev);
+    }
+    pthread_mutex_unlock(&m_mutexRecovery);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// noteResult
+//
+
+void
+CCanalIf::noteResult(int rv)
+{
+    if (CANAL_ERROR_SUCCESS == rv) {
+        // Only write when needed, this is on every frame
+        if (m_cntDriverErrors) {
+            m_cntDriverErrors = 0;
+        }
+        return;
+    }
+
+    if (!m_config.bRecover) {
+        return;
+    }
+
+    // Normal results for a working driver
+    switch (rv) {
+        case CANAL_ERROR_FIFO_EMPTY:
+        case CANAL_ERROR_FIFO_FULL:
+        case CANAL_ERROR_TRM_FULL:
+        case CANAL_ERROR_TIMEOUT:
+            return;
+    }
+
+    m_lastDriverError = rv;
+    if (m_config.recoverErrors == ++m_cntDriverErrors) {
+        sem_post(&m_semRecover);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// setTxRate
+//
+
+void
+CCanalIf::setTxRate(const shaperRate *prate)
+{
+    if (NULL == prate) {
+        return;
+    }
+
+    m_config.txRate = *prate;
+    m_txShaper.setRate(prate);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getTxStatistics
+//
+
+void
+CCanalIf::getTxStatistics(txStatistics *pstats, bool bReset)
+{
+    if (NULL == pstats) {
+        return;
+    }
+
+    if (bReset) {
+        pstats->cntSent      = m_cntTxSent.exchange(0);
+        pstats->cntThrottled = m_cntTxThrottled.exchange(0);
+        pstats->throttledUs  = m_txThrottledUs.exchange(0);
+        pstats->cntRetries   = m_cntTxRetries.exchange(0);
+        pstats->cntErrors    = m_cntTxErrors.exchange(0);
+        pstats->cntExpired   = m_cntTxExpired.exchange(0);
+    }
+    else {
+        pstats->cntSent      = m_cntTxSent;
+        pstats->cntThrottled = m_cntTxThrottled;
+        pstats->throttledUs  = m_txThrottledUs;
+        pstats->cntRetries   = m_cntTxRetries;
+        pstats->cntErrors    = m_cntTxErrors;
+        pstats->cntExpired   = m_cntTxExpired;
+    }
+
+    pthread_mutex_lock(&m_mutexClientInputQueue);
+    pstats->queued = (uint32_t)m_clientInputQueue.size();
+    pthread_mutex_unlock(&m_mutexClientInputQueue);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// waitQuit
+//
+
+bool
+CCanalIf::waitQuit(uint32_t ms)
+{
+    struct timespec ts;
+    absTimeout(&ts, ms);
+
+    // Woken early by close, or by stale failure reports
+    while (!m_bQuit && (0 == sem_timedwait(&m_semRecover, &ts))) {
+        ;
+    }
+
+    return m_bQuit;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// recover
+//
+
+void
+CCanalIf::recover(void)
+{
+    recoveryEvent ev;
+    memset(&ev, 0, sizeof(recoveryEvent));
+
+    long handle = m_openHandle.exchange(0);
+    if (0 == handle) {
+        return;
+    }
+
+    syslog(LOG_ERR,
+           "Driver failed (%d), reopening [%s]",
+           (int)m_lastDriverError,
+           m_strPath.c_str());
+
+    ev.state = RECOVER_STATE_LOST;
+    ev.rv = m_lastDriverError;
+    notifyRecovery(&ev);
+
+    // Let calls that already got the handle return before it goes
+    if (waitQuit(m_config.receiveTimeout + 10)) {
+        m_proc_CanalClose(handle);
+        return;
+    }
+    m_proc_CanalClose(handle);
+
+    uint32_t backoffMs = m_config.recoverMinBackoffMs;
+    for (uint32_t attempt = 1; ; attempt++) {
+
+        if (waitQuit(backoffMs)) {
+            return;
+        }
+
+        ev.state = RECOVER_STATE_REOPENING;
+        ev.rv = CANAL_ERROR_SUCCESS;
+        ev.attempt = attempt;
+        ev.backoffMs = 0;
+        notifyRecovery(&ev);
+
+        handle = m_proc_CanalOpen((const char *)m_strParameter.c_str(),
+                                    m_deviceFlags);
+        if (handle > 0) {
+            applyConfig(handle);
+            m_cntDriverErrors = 0;
+            m_cntRecoveries++;
+            m_openHandle = handle;
+
+            syslog(LOG_INFO, "Driver reopened after %u attempts", attempt);
+
+            ev.state = RECOVER_STATE_RECOVERED;
+            notifyRecovery(&ev);
+            m_recoverState = RECOVER_STATE_OK;
+
+            // Held sends can go now
+            sem_post(&m_semClientInputQueue);
+            return;
+        }
+
+        // Double the delay up to the limit
+        backoffMs = (backoffMs > m_config.recoverMaxBackoffMs / 2) ?
+                        m_config.recoverMaxBackoffMs : 2 * backoffMs;
+
+        ev.state = RECOVER_STATE_FAILED;
+        ev.rv = CANAL_ERROR_NOT_OPEN;
+        ev.backoffMs = backoffMs;
+        notifyRecovery(&ev);
+    }
+}
+
+
 /////////////////////////////////////////////////////////////////////////////
 // Device read worker thread
 /////////////////////////////////////////////////////////////////////////////
@@ -732,9 +1697,32 @@ deviceReceiveThread(void *pData)
 
 // ****************************************************************************
 
+///////////////////////////////////////////////////////////////////////////////
+// requeueFrame
+//
+// Put a frame that is to be tried again back in its place in the
+// send queue and wake the send thread for it.
+//
+
+static void
+requeueFrame(CCanalIf *pif, txFrame *pframe)
+{
+    pthread_mutex_lock(&pif->m_mutexClientInputQueue);
+    pif->m_clientInputQueue.putBack(pframe);
+    pthread_mutex_unlock(&pif->m_mutexClientInputQueue);
+
+    sem_post(&pif->m_semClientInputQueue);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // deviceWriteThread
 //
+// Write frames queued by CanalSend, most urgent first, at the rate
+// the shaper allows. A frame the driver had no room for goes back to
+// its place in the queue and is retried with backoff, a frame it
+// rejected is dropped. While the driver is being reopened frames are
+// held, and dropped when too old.
+//
 
 void *
 deviceWriteThread(void *pData)
@@ -743,42 +1731,161 @@ deviceWriteThread(void *pData)
     if (NULL == pif) {
         syslog(
           LOG_ERR,
-          "deviceLevel1ReceiveThread quitting due to NULL DevItem object.");
+          "deviceWriteThread quitting due to NULL pif object.");
         return NULL;
     }
 
-    // Blocking send method must have been found
-    if (NULL == pif->m_proc_CanalBlockingSend) return NULL;
+    rtApplyTuning(&pif->m_tuning);
+
+    uint32_t retryUs = pif->m_config.txRetryMinUs;
 
     while (!pif->m_bQuit) {
 
         // Wait until there is something to send
-        if ((-1 == sem_wait(
-                     &pif->m_semClientInputQueue)) &&
-            errno == ETIMEDOUT) {
+        struct timespec ts;
+        absTimeout(&ts, pif->m_config.receiveTimeout);
+        if (-1 == sem_timedwait(&pif->m_semClientInputQueue, &ts)) {
             continue;
         }
 
-        if (pif->m_clientInputQueue.size()) {
+        long handle = pif->m_openHandle;
+        std::chrono::steady_clock::time_point oldest =
+            std::chrono::steady_clock::now() -
+            std::chrono::milliseconds(pif->m_config.txMaxAgeMs);
+
+        pthread_mutex_lock(&pif->m_mutexClientInputQueue);
 
-            pthread_mutex_lock(&pif->m_mutexClientInputQueue);
-            canalMsg *pmsg =
-              pif->m_clientInputQueue.front();
-            pif->m_clientInputQueue.pop_front();
+        // Hold frames while the driver is reopened
+        if (0 == handle) {
+            if (pif->m_config.txMaxAgeMs) {
+                pif->m_cntTxExpired += pif->m_clientInputQueue.expire(oldest);
+            }
+            bool bHeld = !pif->m_clientInputQueue.isEmpty();
             pthread_mutex_unlock(&pif->m_mutexClientInputQueue);
 
-            if (CANAL_ERROR_SUCCESS ==
-                pif->m_proc_CanalBlockingSend(
-                  pif->m_openHandle, pmsg, 300)) {
-                //vscp_deleteVSCPevent(pqueueEvent);
-            } else {
-                // Give it another try
-                sem_post(&pif->m_semClientOutputQueue);
+            if (bHeld) {
+                sem_post(&pif->m_semClientInputQueue);
+                usleep(1000);
             }
+            continue;
+        }
 
-        } // events in queue
+        // Next frame that is not too old
+        txFrame frame;
+        bool bFrame = false;
+        while (pif->m_clientInputQueue.pop(&frame)) {
+            if (pif->m_config.txMaxAgeMs && (frame.queued < oldest)) {
+                pif->m_cntTxExpired++;
+                continue;
+            }
+            bFrame = true;
+            break;
+        }
+        pthread_mutex_unlock(&pif->m_mutexClientInputQueue);
+
+        if (!bFrame) {
+            continue;
+        }
+
+        // Over the rate. Put it back so a more urgent frame queued
+        // while waiting goes first.
+        uint64_t waitUs = pif->m_txShaper.acquire(&frame.msg);
+        if (waitUs) {
+            requeueFrame(pif, &frame);
+
+            // Stay responsive to quit
+            if (waitUs > 1000ULL * pif->m_config.receiveTimeout) {
+                waitUs = 1000ULL * pif->m_config.receiveTimeout;
+            }
+            pif->m_cntTxThrottled++;
+            pif->m_txThrottledUs += waitUs;
+            usleep((useconds_t)waitUs);
+            continue;
+        }
+
+        int rv;
+        if (NULL != pif->m_proc_CanalBlockingSend) {
+            rv = pif->m_proc_CanalBlockingSend(handle,
+                                                &frame.msg,
+                                                pif->m_config.receiveTimeout);
+        }
+        else {
+            rv = pif->m_proc_CanalSend(handle, &frame.msg);
+        }
+        pif->noteResult(rv);
+
+        if (CANAL_ERROR_SUCCESS == rv) {
+            pif->m_cntTxSent++;
+            retryUs = pif->m_config.txRetryMinUs;
+            if (pif->m_bBusLoad) {
+                pif->m_busLoad.add(&frame.msg);
+            }
+        }
+        else {
+            switch (rv) {
+
+                // No room in the driver. Back off, doubling the delay
+                // until it takes frames again.
+                case CANAL_ERROR_FIFO_FULL:
+                case CANAL_ERROR_TRM_FULL:
+                    requeueFrame(pif, &frame);
+                    pif->m_cntTxRetries++;
+                    usleep(retryUs);
+                    retryUs *= 2;
+                    if (retryUs > pif->m_config.txRetryMaxUs) {
+                        retryUs = pif->m_config.txRetryMaxUs;
+                    }
+                    break;
+
+                // Blocking send already waited
+                case CANAL_ERROR_TIMEOUT:
+                    requeueFrame(pif, &frame);
+                    pif->m_cntTxRetries++;
+                    break;
+
+                // Rejected. Trying again would only block the frames
+                // behind it.
+                default:
+                    pif->m_cntTxErrors++;
+                    break;
+            }
+        }
 
     } // while
 
     return NULL;
 }
+
+///////////////////////////////////////////////////////////////////////////////
+// deviceRecoverThread
+//
+// Wait for noteResult to report a failed driver and reopen it.
+//
+
+void *
+deviceRecoverThread(void *pData)
+{
+    CCanalIf *pif = (CCanalIf *)pData;
+    if (NULL == pif) {
+        syslog(
+          LOG_ERR,
+          "deviceRecoverThread quitting due to NULL pif object.");
+        return NULL;
+    }
+
+    while (!pif->m_bQuit) {
+
+        struct timespec ts;
+        absTimeout(&ts, pif->m_config.receiveTimeout);
+        if (-1 == sem_timedwait(&pif->m_semRecover, &ts)) {
+            continue;
+        }
+
+        if (!pif->m_bQuit &&
+            (pif->m_cntDriverErrors >= pif->m_config.recoverErrors)) {
+            pif->recover();
+        }
+    }
+
+    return NULL;
+}
@@ -32,13 +32,42 @@
 #include <semaphore.h>
 #include <napi.h>
 
+#include "busload.h"
 #include "canaldlldef.h"
+#include "idstats.h"
+#include "rtsched.h"
+#include "shaper.h"
+#include "txqueue.h"
 
+#include <atomic>
+#include <functional>
 #include <string>
 #include <list>
 
 const int MAX_CAN_MESSAGES = 1000;
 
+// Default blocking receive timeout for the native threads (ms)
+#define CANALIF_DEFAULT_RECEIVE_TIMEOUT     500
+
+// Default frames per batch for streams and broadcast readers
+#define CANALIF_DEFAULT_BATCH_SIZE          64
+
+// Recovery defaults
+#define CANALIF_DEFAULT_RECOVER_ERRORS      5       // Driver errors in a row
+#define CANALIF_DEFAULT_RECOVER_MIN_MS      100     // First reopen delay
+#define CANALIF_DEFAULT_RECOVER_MAX_MS      10000   // Longest reopen delay
+
+// Retry of sends the driver had no room for
+#define CANALIF_DEFAULT_TX_RETRY_MIN_US     100     // First retry delay
+#define CANALIF_DEFAULT_TX_RETRY_MAX_US     10000   // Longest retry delay
+
+// Recovery states reported to the recovery callback
+#define RECOVER_STATE_OK                    0       // Channel works
+#define RECOVER_STATE_LOST                  1       // Driver failed, closed
+#define RECOVER_STATE_REOPENING             2       // Trying to reopen
+#define RECOVER_STATE_FAILED                3       // Reopen failed, will retry
+#define RECOVER_STATE_RECOVERED             4       // Reopened
+
 // An item that will be generated from the thread, passed into JavaScript, and
 // ultimately marked as resolved when the JavaScript passes it back into the
 // addon instance with a return value.
@@ -46,6 +75,82 @@ const int MAX_CAN_MESSAGES = 1000;
 // Forward declaration
 class CCanalIf;
 
+/*!
+    Statistics for the receive used by the native threads. Latency
+    is how much later than the fastest frame seen a frame was picked
+    up, measured against the driver timestamp (us). It is only
+    meaningful for drivers that timestamp frames in microseconds.
+*/
+typedef struct structReceiveStatistics {
+    uint64_t cntSpinFrames;             // Frames picked up while spinning
+    uint64_t cntBlockingFrames;         // Frames from the blocking receive
+    uint64_t cntSpinMisses;             // Spins that ended without a frame
+    uint64_t spinUs;                    // Time spent spinning (CPU time)
+    double avgLatencyUs;                // Average latency
+    uint32_t maxLatencyUs;              // Max latency
+} receiveStatistics;
+
+/*!
+    Structured init data. See init(std::string jsonInit) for the
+    JSON form. Set defaults with initConfig.
+*/
+typedef struct structCanalConfig {
+    std::string path;                   // Path to CANAL driver
+    std::string config;                 // CANAL configuration string
+    uint32_t flags;                     // CANAL flags
+    bool bAsync;                        // Queue sends to a native thread
+    uint32_t receiveTimeout;            // Blocking receive timeout (ms)
+    uint32_t spinUs;                    // Receive spin before blocking
+    uint32_t txQueueSize;               // Max frames in async send queue
+    int txOrder;                        // TXQUEUE_ORDER_* in a priority class
+    uint32_t streamCapacity;            // Default frame stream ring size
+    uint32_t broadcastCapacity;         // Default broadcast ring size
+    uint32_t batchSize;                 // Default frames per batch
+    uint32_t deliveryMaxFrames;         // Listener delivery policy
+    uint32_t deliveryMaxHoldUs;
+    bool bColumnar;                     // Listener delivers column batches
+    bool bFilter;                       // Set filter on open
+    uint32_t filter;
+    bool bMask;                         // Set mask on open
+    uint32_t mask;
+    bool bBaudrate;                     // Set baudrate on open
+    uint32_t baudrate;
+    bool bRecover;                      // Reopen when the driver fails
+    uint32_t recoverErrors;             // Driver errors in a row that is a failure
+    uint32_t recoverMinBackoffMs;       // First reopen delay
+    uint32_t recoverMaxBackoffMs;       // Longest reopen delay
+    uint32_t txMaxAgeMs;                // Drop queued sends older, 0 = never
+    shaperRate txRate;                  // Async send rate limits
+    uint32_t txRetryMinUs;              // First retry delay on full driver
+    uint32_t txRetryMaxUs;              // Longest retry delay on full driver
+    threadTuning tuning;                // Scheduling of native threads
+} canalConfig;
+
+/*!
+    Recovery state change
+*/
+typedef struct structRecoveryEvent {
+    int state;                          // RECOVER_STATE_*
+    int rv;                             // Driver error that caused it
+    uint32_t attempt;                   // Reopen attempt, from one
+    uint32_t backoffMs;                 // Delay before next attempt
+    uint32_t cntRecoveries;             // Successful reopens
+    uint64_t cntTxExpired;              // Queued sends dropped for age
+} recoveryEvent;
+
+/*!
+    Async send statistics
+*/
+typedef struct structTxStatistics {
+    uint64_t cntSent;                   // Frames the driver took
+    uint64_t cntThrottled;              // Times a frame waited for the shaper
+    uint64_t throttledUs;               // Time spent waiting for the shaper
+    uint64_t cntRetries;                // Retries after a full driver FIFO
+    uint64_t cntErrors;                 // Dropped, rejected by the driver
+    uint64_t cntExpired;                // Queued sends dropped for age
+    uint32_t queued;                    // Frames in the queue now
+} txStatistics;
+
 // The data associated with an instance of the addon. This takes the place of
 // global static variables, while allowing multiple instances of the addon to
 // co-exist.
@@ -71,7 +176,8 @@ public:
         @param strpath CANAL driver pathn string
         @param strparam CANAL configuration string
         @param flags CANAL flags
-        @param bAsync True to enable driver asynchronous functionally
+        @param bAsync True to queue sends and write them to the driver
+                    from a native thread
         @return CANAL_ERROR_SUCCESS on success, CANAL error code on failure
     */
 
@@ -80,18 +186,75 @@ public:
     /*!
         Initialize driver with JSON data
 
-        @param jsonInit Init data as a JSON object
+        @param jsonInit Init data as a JSON object. Only path is
+                    required.
         {
-            "path"   : "path to CANAL driver",
-            "config" : "CANAL configuration string",
-            "flags"  : 12345
-            "bAsync" : true|false
+            "path"              : "path to CANAL driver",
+            "config"            : "CANAL configuration string",
+            "flags"             : 12345,
+            "bAsync"            : true|false,
+            "receiveTimeout"    : 500,
+            "spinUs"            : 0,
+            "txQueueSize"       : 1000,
+            "txOrder"           : "fifo"|"id",
+            "streamCapacity"    : 4096,
+            "broadcastCapacity" : 4096,
+            "batchSize"         : 64,
+            "delivery"          : "lowLatency"|"highThroughput"|
+                                    { "maxFrames" : 1, "maxHoldUs" : 0 },
+            "deliveryFormat"    : "objects"|"columnar",
+            "filter"            : 0,
+            "mask"              : 0,
+            "baudrate"          : 3,
+            "recover"           : true|false|
+                                    { "errors" : 5, "minBackoffMs" : 100,
+                                      "maxBackoffMs" : 10000 },
+            "txMaxAgeMs"        : 0,
+            "txRate"            : { "framesPerSec" : 0, "bitsPerSec" : 0,
+                                    "burstFrames" : 16, "burstBits" : 2560 },
+            "txRetry"           : { "minUs" : 100, "maxUs" : 10000 },
+            "schedPolicy"       : "fifo"|"rr"|"other",
+            "schedPriority"     : 50,
+            "cpus"              : [ 2, 3 ],
+            "lockMemory"        : true|false,
+            "prefaultStackKb"   : 64
         }
-        @return CANAL_ERROR_SUCCESS on success, CANAL error code on failure
+        @return CANAL_ERROR_SUCCESS on success, CANAL error code on
+                    failure. m_strError describe what was wrong.
     */
 
     int init( std::string jsonInit );
 
+    /*!
+        Initialize driver from structured init data
+
+        @param pcfg Init data
+        @return CANAL_ERROR_SUCCESS on success, CANAL error code on
+                    failure. m_strError describe what was wrong.
+    */
+    int init(const canalConfig *pcfg);
+
+    /*!
+        Set init data defaults
+
+        @param pcfg Init data to fill in
+    */
+    static void initConfig(canalConfig *pcfg);
+
+    /*!
+        Read init data from JSON. Members not in the JSON are
+        left as they are.
+
+        @param jsonInit Init data as a JSON object, see init
+        @param pcfg Init data to fill in
+        @param strError Receives a description of what was wrong
+        @return CANAL_ERROR_SUCCESS on success, CANAL_ERROR_PARAMETER
+                    on failure.
+    */
+    static int parseConfig(const std::string &jsonInit,
+                            canalConfig *pcfg,
+                            std::string &strError);
+
     /*!
         CanalOpen
     */
@@ -106,10 +269,12 @@ public:
         CanalSend - Send CAN message
 
         @param pcanmsp Pointer to can message
-
+        @param priority Priority class in the async send queue,
+                    TXQUEUE_PRIORITY_HIGHEST is sent first
         @return CANAL_ERROR_SUCCESS on success, CANAL error code on failure
     */
-    int CanalSend( canalMsg* pcanmsg );
+    int CanalSend( canalMsg* pcanmsg,
+                    uint8_t priority = TXQUEUE_PRIORITY_DEFAULT );
 
     /*!
         CanalBlockingSend
@@ -128,6 +293,8 @@ public:
     /*!
         CanalBlockingReceive
 
+        @param pcanmsg Pointer to CAN message that receives the frame
+        @param timeout Timeout in milliseconds. Zero is forever.
         @return CANAL_ERROR_SUCCESS on success, CANAL error code on failure
     */
     int CanalBlockingReceive(canalMsg* pcanmsg, uint32_t timeout=0);
@@ -138,6 +305,36 @@ public:
     */
     int CanalDataAvailable(void);
 
+    /*!
+        Receive used by the native receive threads. If a spin time
+        is set CanalDataAvailable is polled that long before falling
+        back to CanalBlockingReceive.
+
+        @param pcanmsg Pointer to CAN message that receives the frame
+        @param timeout Timeout in milliseconds for the blocking receive
+        @return CANAL_ERROR_SUCCESS on success, CANAL error code on failure
+    */
+    int receive(canalMsg *pcanmsg, uint32_t timeout);
+
+    /*!
+        Set time to spin before blocking
+
+        @param spinUs Microseconds to spin, zero to always block
+    */
+    void setReceiveSpin(uint32_t spinUs) { m_spinUs = spinUs; };
+
+    /*!
+        Get receive statistics
+
+        @param pstats Pointer to statistics structure to fill in
+    */
+    void getReceiveStatistics(receiveStatistics *pstats);
+
+    /*!
+        Clear receive statistics
+    */
+    void resetReceiveStatistics(void);
+
     /*!
         CanalGetStatus
 
@@ -198,6 +395,43 @@ public:
     */
     int CanalSetBaudrate(uint32_t baudrate);
 
+    /*!
+        Set callback for recovery state changes. It is called from
+        the recovery thread.
+
+        @param callback Called with each change, empty for none
+    */
+    void setRecoveryCallback(std::function<void(const recoveryEvent *)> callback);
+
+    /*!
+        Account the result of a driver call. Enough failures in a
+        row start a reopen if recovery is enabled.
+
+        @param rv Result of driver call
+    */
+    void noteResult(int rv);
+
+    /*!
+        Close the failed driver and reopen it with backoff. Called
+        from the recovery thread.
+    */
+    void recover(void);
+
+    /*!
+        Set rate limits for async sends. Takes effect at once.
+
+        @param prate Limits, zero rates are unlimited
+    */
+    void setTxRate(const shaperRate *prate);
+
+    /*!
+        Get async send statistics
+
+        @param pstats Receives the statistics
+        @param bReset True to zero counters after reading them
+    */
+    void getTxStatistics(txStatistics *pstats, bool bReset = false);
+
     /*!
         CanalGetLevel
 
@@ -239,9 +473,56 @@ public:
     // Worker thread data
     bool m_bQuit;
 
+    // Init data in use
+    canalConfig m_config;
+
+    // Description of last init error
+    std::string m_strError;
+
+    // Scheduling of the native I/O threads using this interface
+    threadTuning m_tuning;
+
+    // Microseconds receive spins before it blocks
+    std::atomic<uint32_t> m_spinUs;
+
+    // Receive statistics
+    pthread_mutex_t m_mutexReceiveStatistics;
+    receiveStatistics m_receiveStatistics;
+    uint64_t m_cntLatency;
+    double m_sumLatencyUs;
+    bool m_bLatencyRef;
+    uint32_t m_latencyRef;              // Offset of first frame
+    int32_t m_minLatency;               // Lowest offset relative to first
+
+    // Per id statistics for frames from receive
+    std::atomic<bool> m_bIdStatistics;
+    CIdStatistics m_idStatistics;
+
+    // Bus load from frames received and sent
+    std::atomic<bool> m_bBusLoad;
+    CBusLoad m_busLoad;
+
+    // Rate limits and statistics for async sends
+    CTxShaper m_txShaper;
+    std::atomic<uint64_t> m_cntTxSent;
+    std::atomic<uint64_t> m_cntTxThrottled;
+    std::atomic<uint64_t> m_txThrottledUs;
+    std::atomic<uint64_t> m_cntTxRetries;
+    std::atomic<uint64_t> m_cntTxErrors;
+
     // Queues
     std::list<canalMsg*> m_clientOutputQueue;
-    std::list<canalMsg*> m_clientInputQueue;
+    CTxQueue m_clientInputQueue;
+
+    // Recovery
+    std::atomic<int> m_recoverState;
+    std::atomic<uint32_t> m_cntDriverErrors;    // Failures in a row
+    std::atomic<int> m_lastDriverError;
+    std::atomic<uint32_t> m_cntRecoveries;
+    std::atomic<uint64_t> m_cntTxExpired;
+    pthread_mutex_t m_mutexRecovery;            // Protects the callback
+    std::function<void(const recoveryEvent *)> m_recoveryCallback;
+    sem_t m_semRecover;
 
     // Protecters for queues
     pthread_mutex_t m_mutexClientOutputQueue;
@@ -253,14 +534,23 @@ public:
 
 public:
 
-    // Handle for dll/dl driver interface
-    long m_openHandle;
+    // Handle for dll/dl driver interface. Zero while closed or
+    // being reopened.
+    std::atomic<long> m_openHandle;
     
     // DLL handle
     void *m_hdll;
 
     pthread_t m_wrkthread;
 
+    // Async send thread
+    pthread_t m_writeThread;
+    bool m_bWriteThread;
+
+    // Recovery thread
+    pthread_t m_recoverThread;
+    bool m_bRecoverThread;
+
     // Level I (CANAL) driver methods
     LPFNDLL_CANALOPEN m_proc_CanalOpen;
     LPFNDLL_CANALCLOSE m_proc_CanalClose;
@@ -296,6 +586,15 @@ private:
     // VSCP level for driver
     long m_driverLevel;
 
+    // Set filter, mask and baudrate from init data on a new handle
+    void applyConfig(long handle);
+
+    // Report a recovery state change
+    void notifyRecovery(recoveryEvent *pev);
+
+    // Sleep unless told to quit. Returns true if told to quit.
+    bool waitQuit(uint32_t ms);
+
     // ------------------------------------------------------------------------
     //                     End of driver worker thread data
     // ------------------------------------------------------------------------
@@ -0,0 +1,167 @@
+///////////////////////////////////////////////////////////////////////////
+// canalworkers.cpp
+//
+// Async workers that run blocking CANAL driver calls off the JS
+// thread and settle a Promise with the result.
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <string.h>
+
+#include <chrono>
+#include <thread>
+
+#include "canalworkers.h"
+#include "node-canal.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// CCanalWorker
+//
+
+CCanalWorker::CCanalWorker(Napi::Object wrapper, CCanalIf *pif)
+    : Napi::AsyncWorker(wrapper.Env(), "CCanalWorker"),
+      m_pif(pif),
+      m_rv(CANAL_ERROR_SUCCESS),
+      m_bResolveCode(false),
+      m_deferred(Napi::Promise::Deferred::New(wrapper.Env())),
+      m_wrapper(Napi::Persistent(wrapper)) {
+}
+
+void CCanalWorker::OnOK(void) {
+  Napi::Env env = Env();
+  Napi::HandleScope scope(env);
+
+  if (m_bResolveCode) {
+    m_deferred.Resolve(Napi::Number::New(env, m_rv));
+  }
+  else if (CANAL_ERROR_SUCCESS == m_rv) {
+    m_deferred.Resolve(Result(env));
+  }
+  else {
+    Napi::Error err = Napi::Error::New(env, "CANAL call failed");
+    err.Value().Set("code", m_rv);
+    m_deferred.Reject(err.Value());
+  }
+
+  m_wrapper.Reset();
+}
+
+void CCanalWorker::OnError(const Napi::Error &e) {
+  Napi::HandleScope scope(Env());
+  m_deferred.Reject(e.Value());
+  m_wrapper.Reset();
+}
+
+Napi::Value CCanalWorker::Result(Napi::Env env) {
+  return Napi::Number::New(env, m_rv);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// COpenWorker
+//
+
+void COpenWorker::Execute(void) {
+  m_rv = m_pif->CanalOpen();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CCloseWorker
+//
+
+void CCloseWorker::Execute(void) {
+  // The listener thread may be in the driver until it has quit
+  while (*m_pbListenerRunning) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  m_rv = m_pif->CanalClose();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CGetStatusWorker
+//
+
+void CGetStatusWorker::Execute(void) {
+  memset(&m_status, 0, sizeof(canalStatus));
+  m_rv = m_pif->CanalGetStatus(&m_status);
+}
+
+Napi::Value CGetStatusWorker::Result(Napi::Env env) {
+  return statusToObject(env, &m_status);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CGetStatisticsWorker
+//
+
+void CGetStatisticsWorker::Execute(void) {
+  memset(&m_statistics, 0, sizeof(canalStatistics));
+  m_rv = m_pif->CanalGetStatistics(&m_statistics);
+}
+
+Napi::Value CGetStatisticsWorker::Result(Napi::Env env) {
+  return statisticsToObject(env, &m_statistics);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CSetBaudrateWorker
+//
+
+void CSetBaudrateWorker::Execute(void) {
+  m_rv = m_pif->CanalSetBaudrate(m_baudrate);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CSendBlockingWorker
+//
+
+CSendBlockingWorker::CSendBlockingWorker(Napi::Object wrapper,
+                                            CCanalIf *pif,
+                                            const canalMsg *pmsg,
+                                            uint32_t timeout)
+    : CCanalWorker(wrapper, pif),
+      m_timeout(timeout) {
+  // A timeout or full FIFO is an answer, not a failure
+  m_bResolveCode = true;
+  memcpy(&m_msg, pmsg, sizeof(canalMsg));
+}
+
+void CSendBlockingWorker::Execute(void) {
+  m_rv = m_pif->CanalBlockingSend(&m_msg, m_timeout);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CReceiveWorker
+//
+
+void CReceiveWorker::Execute(void) {
+  memset(&m_msg, 0, sizeof(canalMsg));
+  m_rv = m_pif->CanalBlockingReceive(&m_msg, m_timeout);
+}
+
+Napi::Value CReceiveWorker::Result(Napi::Env env) {
+  return msgToObject(env, &m_msg);
+}
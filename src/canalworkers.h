@@ -0,0 +1,170 @@
+///////////////////////////////////////////////////////////////////////////
+// canalworkers.h
+//
+// Async workers that run blocking CANAL driver calls off the JS
+// thread and settle a Promise with the result.
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#if !defined(CANALWORKERS_H)
+#define CANALWORKERS_H
+
+#include <napi.h>
+
+#include <atomic>
+
+#include "canalif.h"
+
+/*!
+    Base for the async workers. The promise is resolved with the
+    value from Result() when the CANAL call return
+    CANAL_ERROR_SUCCESS and rejected with an Error holding the
+    CANAL error code in "code" otherwise. Workers that set
+    m_bResolveCode resolve with the CANAL code in all cases.
+
+    The JS object owning the CANAL interface is referenced until
+    the worker is done so it can not be collected, and the driver
+    closed, under a running worker.
+*/
+class CCanalWorker : public Napi::AsyncWorker {
+
+public:
+
+    CCanalWorker(Napi::Object wrapper, CCanalIf *pif);
+    virtual ~CCanalWorker() {};
+
+    /*!
+        Promise settled when the worker is done
+    */
+    Napi::Promise Promise(void) { return m_deferred.Promise(); };
+
+protected:
+
+    void OnOK(void) override;
+    void OnError(const Napi::Error &e) override;
+
+    /*!
+        Value the promise is resolved with. Default is the
+        CANAL return code.
+    */
+    virtual Napi::Value Result(Napi::Env env);
+
+    // CANAL interface
+    CCanalIf *m_pif;
+
+    // Return code from CANAL call
+    int m_rv;
+
+    // Resolve with the return code also on failure
+    bool m_bResolveCode;
+
+private:
+
+    Napi::Promise::Deferred m_deferred;
+
+    // Keeps the owner of m_pif alive
+    Napi::ObjectReference m_wrapper;
+};
+
+// CanalOpen
+class COpenWorker : public CCanalWorker {
+public:
+    COpenWorker(Napi::Object wrapper, CCanalIf *pif) : CCanalWorker(wrapper, pif) {};
+protected:
+    void Execute(void) override;
+};
+
+// CanalClose
+class CCloseWorker : public CCanalWorker {
+public:
+    CCloseWorker(Napi::Object wrapper, CCanalIf *pif, std::atomic<bool> *pbListenerRunning)
+        : CCanalWorker(wrapper, pif), m_pbListenerRunning(pbListenerRunning) {};
+protected:
+    void Execute(void) override;
+private:
+    // Cleared when the listener thread no longer use the driver
+    std::atomic<bool> *m_pbListenerRunning;
+};
+
+// CanalGetStatus
+class CGetStatusWorker : public CCanalWorker {
+public:
+    CGetStatusWorker(Napi::Object wrapper, CCanalIf *pif) : CCanalWorker(wrapper, pif) {};
+protected:
+    void Execute(void) override;
+    Napi::Value Result(Napi::Env env) override;
+private:
+    canalStatus m_status;
+};
+
+// CanalGetStatistics
+class CGetStatisticsWorker : public CCanalWorker {
+public:
+    CGetStatisticsWorker(Napi::Object wrapper, CCanalIf *pif) : CCanalWorker(wrapper, pif) {};
+protected:
+    void Execute(void) override;
+    Napi::Value Result(Napi::Env env) override;
+private:
+    canalStatistics m_statistics;
+};
+
+// CanalSetBaudrate
+class CSetBaudrateWorker : public CCanalWorker {
+public:
+    CSetBaudrateWorker(Napi::Object wrapper, CCanalIf *pif, uint32_t baudrate)
+        : CCanalWorker(wrapper, pif), m_baudrate(baudrate) {};
+protected:
+    void Execute(void) override;
+private:
+    uint32_t m_baudrate;
+};
+
+// CanalBlockingSend
+class CSendBlockingWorker : public CCanalWorker {
+public:
+    CSendBlockingWorker(Napi::Object wrapper, CCanalIf *pif, const canalMsg *pmsg, uint32_t timeout);
+protected:
+    void Execute(void) override;
+private:
+    uint32_t m_timeout;
+    canalMsg m_msg;
+};
+
+// CanalBlockingReceive
+class CReceiveWorker : public CCanalWorker {
+public:
+    CReceiveWorker(Napi::Object wrapper, CCanalIf *pif, uint32_t timeout)
+        : CCanalWorker(wrapper, pif), m_timeout(timeout) {};
+protected:
+    void Execute(void) override;
+    Napi::Value Result(Napi::Env env) override;
+private:
+    uint32_t m_timeout;
+    canalMsg m_msg;
+};
+
+#endif
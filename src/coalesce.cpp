@@ -0,0 +1,187 @@
+///////////////////////////////////////////////////////////////////////////
+// coalesce.cpp
+//
+// Coalescing of received frames. Frames are held until a batch is
+// full or the first frame has been held long enough.
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <string.h>
+
+#include "coalesce.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// constructor
+//
+
+CCoalescer::CCoalescer()
+{
+    m_maxFrames = COALESCE_LOW_LATENCY_FRAMES;
+    m_maxHoldUs = COALESCE_LOW_LATENCY_HOLD_US;
+    m_pbatch    = NULL;
+    resetStatistics();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// deconstructor
+//
+
+CCoalescer::~CCoalescer()
+{
+    delete m_pbatch;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// setPolicy
+//
+
+void
+CCoalescer::setPolicy(uint32_t maxFrames, uint32_t maxHoldUs)
+{
+    m_maxFrames = maxFrames ? maxFrames : 1;
+    m_maxHoldUs = maxHoldUs;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// add
+//
+
+bool
+CCoalescer::add(const canalMsg *pmsg)
+{
+    if (NULL == m_pbatch) {
+        m_pbatch = new std::vector<canalMsg>;
+        m_pbatch->reserve(m_maxFrames);
+        m_first = clock::now();
+    }
+
+    m_pbatch->push_back(*pmsg);
+
+    return (m_pbatch->size() >= m_maxFrames);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// isDue
+//
+
+bool
+CCoalescer::isDue(void)
+{
+    if (NULL == m_pbatch) {
+        return false;
+    }
+
+    return ((m_pbatch->size() >= m_maxFrames) ||
+            ((clock::now() - m_first) >= std::chrono::microseconds(m_maxHoldUs)));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// nextTimeout
+//
+
+uint32_t
+CCoalescer::nextTimeout(uint32_t maxwait)
+{
+    if (NULL == m_pbatch) {
+        return maxwait;
+    }
+
+    clock::time_point due = m_first + std::chrono::microseconds(m_maxHoldUs);
+    int64_t ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    due - clock::now()).count();
+
+    // Zero is forever for a blocking receive
+    if (ms < 1) {
+        return 1;
+    }
+
+    return (ms < maxwait) ? (uint32_t)ms : maxwait;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// take
+//
+
+std::vector<canalMsg> *
+CCoalescer::take(void)
+{
+    std::vector<canalMsg> *pbatch = m_pbatch;
+    if (NULL == pbatch) {
+        return NULL;
+    }
+
+    m_pbatch = NULL;
+
+    uint32_t holdUs = (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+                        clock::now() - m_first).count();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_stats.cntBatches++;
+    m_stats.cntFrames += pbatch->size();
+    if (pbatch->size() > m_stats.maxBatch) {
+        m_stats.maxBatch = (uint32_t)pbatch->size();
+    }
+    if (holdUs > m_stats.maxHoldUs) {
+        m_stats.maxHoldUs = holdUs;
+    }
+    m_sumHoldUs += holdUs;
+
+    return pbatch;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getStatistics
+//
+
+void
+CCoalescer::getStatistics(coalesceStatistics *pstats)
+{
+    if (NULL == pstats) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    *pstats = m_stats;
+    if (m_stats.cntBatches) {
+        pstats->avgBatch  = (double)m_stats.cntFrames / m_stats.cntBatches;
+        pstats->avgHoldUs = m_sumHoldUs / m_stats.cntBatches;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// resetStatistics
+//
+
+void
+CCoalescer::resetStatistics(void)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    memset(&m_stats, 0, sizeof(coalesceStatistics));
+    m_sumHoldUs = 0;
+}
@@ -0,0 +1,145 @@
+///////////////////////////////////////////////////////////////////////////
+// coalesce.h
+//
+// Coalescing of received frames. Frames are held until a batch is
+// full or the first frame has been held long enough.
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#if !defined(COALESCE_H)
+#define COALESCE_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+#include "canal.h"
+
+// Delivery profiles
+#define COALESCE_LOW_LATENCY_FRAMES         1       // Deliver each frame at once
+#define COALESCE_LOW_LATENCY_HOLD_US        0
+#define COALESCE_HIGH_THROUGHPUT_FRAMES     64      // Up to 64 frames or 5 ms
+#define COALESCE_HIGH_THROUGHPUT_HOLD_US    5000
+
+/*!
+    Statistics for delivered batches
+*/
+typedef struct structCoalesceStatistics {
+    uint64_t cntBatches;                // # of batches delivered
+    uint64_t cntFrames;                 // # of frames delivered
+    uint32_t maxBatch;                  // Largest batch
+    double avgBatch;                    // Average batch size
+    uint32_t maxHoldUs;                 // Longest time a first frame was held
+    double avgHoldUs;                   // Average time first frame was held
+} coalesceStatistics;
+
+/*!
+    Collects frames in the receive thread. A batch is due when it
+    holds maxFrames frames or when its first frame has been held
+    maxHoldUs microseconds. The policy can be changed from another
+    thread at any time.
+*/
+class CCoalescer {
+
+public:
+
+    CCoalescer();
+    ~CCoalescer();
+
+    /*!
+        Set delivery policy
+
+        @param maxFrames Max frames in a batch, at least one
+        @param maxHoldUs Max time the first frame is held
+    */
+    void setPolicy(uint32_t maxFrames, uint32_t maxHoldUs);
+
+    /*!
+        Add a frame to the batch
+
+        @param pmsg Received frame
+        @return True if the batch is full and should be delivered
+    */
+    bool add(const canalMsg *pmsg);
+
+    /*!
+        Check if the batch should be delivered because of its age
+
+        @return True if there is a batch that has been held long enough
+    */
+    bool isDue(void);
+
+    /*!
+        Get time until the batch is due
+
+        @param maxwait Longest time to return
+        @return Milliseconds until due, at most maxwait and never zero.
+    */
+    uint32_t nextTimeout(uint32_t maxwait);
+
+    /*!
+        Take the batch for delivery
+
+        @return Batch, owned by the caller. NULL if empty.
+    */
+    std::vector<canalMsg> *take(void);
+
+    bool isEmpty(void) { return (NULL == m_pbatch); };
+
+    /*!
+        Get statistics
+
+        @param pstats Pointer to statistics structure to fill in
+    */
+    void getStatistics(coalesceStatistics *pstats);
+
+    /*!
+        Clear statistics
+    */
+    void resetStatistics(void);
+
+private:
+
+    typedef std::chrono::steady_clock clock;
+
+    std::atomic<uint32_t> m_maxFrames;
+    std::atomic<uint32_t> m_maxHoldUs;
+
+    // Batch being collected, only used by the receive thread
+    std::vector<canalMsg> *m_pbatch;
+    clock::time_point m_first;
+
+    // Protects statistics
+    std::mutex m_mutex;
+    coalesceStatistics m_stats;
+    double m_sumHoldUs;
+};
+
+#endif
@@ -0,0 +1,285 @@
+///////////////////////////////////////////////////////////////////////////
+// cyclic.cpp
+//
+// Periodic transmit scheduler. Sends frames at absolute deadlines
+// from a native thread.
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <string.h>
+
+#include "canal.h"
+#include "cyclic.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// constructor
+//
+
+CCyclicScheduler::CCyclicScheduler()
+{
+    m_pif    = NULL;
+    m_nextId = 1;
+    m_bQuit  = false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// deconstructor
+//
+
+CCyclicScheduler::~CCyclicScheduler()
+{
+    stop();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// add
+//
+
+uint32_t
+CCyclicScheduler::add(const canalMsg *pmsg,
+                        uint64_t periodUs,
+                        uint64_t delayUs,
+                        uint32_t count)
+{
+    if ((NULL == pmsg) || (periodUs < CYCLIC_MIN_PERIOD_US)) {
+        return 0;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    uint32_t id    = m_nextId++;
+    cyclicJob &job = m_jobs[id];
+
+    memcpy(&job.msg, pmsg, sizeof(canalMsg));
+    memset(&job.stat, 0, sizeof(cyclicStatistics));
+    job.periodUs      = periodUs;
+    job.remaining     = count;
+    job.deadline      = clock::now() + std::chrono::microseconds(delayUs);
+    job.stat.periodUs = periodUs;
+    job.sumJitterUs   = 0;
+
+    m_deadlines.push(deadlineEntry(job.deadline, id));
+
+    // Start scheduler on first job
+    if (!m_thread.joinable()) {
+        m_bQuit  = false;
+        m_thread = std::thread(&CCyclicScheduler::workThread, this);
+    }
+
+    m_cv.notify_one();
+
+    return id;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// update
+//
+
+int
+CCyclicScheduler::update(uint32_t id, const canalMsg *pmsg, uint64_t periodUs)
+{
+    if (periodUs && (periodUs < CYCLIC_MIN_PERIOD_US)) {
+        return CANAL_ERROR_PARAMETER;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_jobs.find(id);
+    if (m_jobs.end() == it) {
+        return CANAL_ERROR_PARAMETER;
+    }
+
+    // Swapped under the lock so a send never sees a half written frame
+    if (NULL != pmsg) {
+        memcpy(&it->second.msg, pmsg, sizeof(canalMsg));
+    }
+
+    if (periodUs) {
+        it->second.periodUs      = periodUs;
+        it->second.stat.periodUs = periodUs;
+    }
+
+    return CANAL_ERROR_SUCCESS;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// remove
+//
+
+int
+CCyclicScheduler::remove(uint32_t id)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // Queue entry is dropped when it reach the top
+    if (0 == m_jobs.erase(id)) {
+        return CANAL_ERROR_PARAMETER;
+    }
+
+    return CANAL_ERROR_SUCCESS;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// stop
+//
+
+void
+CCyclicScheduler::stop(void)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_bQuit = true;
+        m_jobs.clear();
+        m_deadlines = decltype(m_deadlines)();
+        m_cv.notify_one();
+    }
+
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getStatistics
+//
+
+int
+CCyclicScheduler::getStatistics(uint32_t id, cyclicStatistics *pstat)
+{
+    if (NULL == pstat) {
+        return CANAL_ERROR_PARAMETER;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_jobs.find(id);
+    if (m_jobs.end() == it) {
+        return CANAL_ERROR_PARAMETER;
+    }
+
+    *pstat = it->second.stat;
+    if (it->second.stat.cntSent + it->second.stat.cntErrors) {
+        pstat->avgJitterUs =
+          it->second.sumJitterUs /
+          (it->second.stat.cntSent + it->second.stat.cntErrors);
+    }
+
+    return CANAL_ERROR_SUCCESS;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// workThread
+//
+
+void
+CCyclicScheduler::workThread(void)
+{
+    if (NULL != m_pif) {
+        rtApplyTuning(&m_pif->m_tuning);
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (!m_bQuit) {
+
+        // Skip entries for removed jobs
+        while (!m_deadlines.empty()) {
+            auto it = m_jobs.find(m_deadlines.top().second);
+            if ((m_jobs.end() != it) &&
+                (it->second.deadline == m_deadlines.top().first)) {
+                break;
+            }
+            m_deadlines.pop();
+        }
+
+        if (m_deadlines.empty()) {
+            m_cv.wait(lock);
+            continue;
+        }
+
+        // Sleep to the absolute deadline. Woken early if a job
+        // with an earlier deadline is added.
+        deadlineEntry entry = m_deadlines.top();
+        if (clock::now() < entry.first) {
+            m_cv.wait_until(lock, entry.first);
+            continue;
+        }
+
+        m_deadlines.pop();
+        canalMsg msg = m_jobs[entry.second].msg;
+
+        // Send without holding the lock
+        lock.unlock();
+        clock::time_point sent = clock::now();
+        int rv = (NULL != m_pif) ? m_pif->CanalSend(&msg) : CANAL_ERROR_NOT_OPEN;
+        lock.lock();
+
+        // Removed while sending
+        auto it = m_jobs.find(entry.second);
+        if (m_jobs.end() == it) {
+            continue;
+        }
+
+        cyclicJob &job = it->second;
+        double jitter =
+          std::chrono::duration<double, std::micro>(sent - entry.first).count();
+
+        if (CANAL_ERROR_SUCCESS == rv) {
+            job.stat.cntSent++;
+        }
+        else {
+            job.stat.cntErrors++;
+            job.stat.lastError = rv;
+        }
+
+        if ((1 == (job.stat.cntSent + job.stat.cntErrors)) ||
+            (jitter < job.stat.minJitterUs)) {
+            job.stat.minJitterUs = jitter;
+        }
+        if (jitter > job.stat.maxJitterUs) {
+            job.stat.maxJitterUs = jitter;
+        }
+        job.sumJitterUs += jitter;
+
+        if (job.remaining && (0 == --job.remaining)) {
+            m_jobs.erase(it);
+            continue;
+        }
+
+        // Stay on the absolute grid. Deadlines already passed are
+        // skipped rather than sent in a burst.
+        std::chrono::microseconds period(job.periodUs);
+        job.deadline = entry.first + period;
+        clock::time_point now = clock::now();
+        while (job.deadline <= now) {
+            job.deadline += period;
+            job.stat.cntMissed++;
+        }
+
+        m_deadlines.push(deadlineEntry(job.deadline, entry.second));
+    }
+}
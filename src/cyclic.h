@@ -0,0 +1,172 @@
+///////////////////////////////////////////////////////////////////////////
+// cyclic.h
+//
+// Periodic transmit scheduler. Sends frames at absolute deadlines
+// from a native thread.
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#if !defined(CYCLIC_H)
+#define CYCLIC_H
+
+#include <stdint.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "canalif.h"
+
+// Shortest allowed period
+#define CYCLIC_MIN_PERIOD_US        100
+
+/*!
+    Statistics for a cyclic job. Jitter is the lateness of each
+    send relative to its absolute deadline.
+*/
+typedef struct structCyclicStatistics {
+    uint32_t cntSent;                   // # of frames sent
+    uint32_t cntErrors;                 // # of failed sends
+    uint32_t cntMissed;                 // # of deadlines skipped
+    int lastError;                      // Last CANAL error code
+    uint64_t periodUs;                  // Current period
+    double minJitterUs;                 // Min lateness
+    double maxJitterUs;                 // Max lateness
+    double avgJitterUs;                 // Average lateness
+} cyclicStatistics;
+
+class CCyclicScheduler {
+
+public:
+
+    CCyclicScheduler();
+    ~CCyclicScheduler();
+
+    /*!
+        Set the CANAL interface jobs are sent on
+
+        @param pif Pointer to CANAL interface
+    */
+    void setInterface(CCanalIf *pif) { m_pif = pif; };
+
+    /*!
+        Add a cyclic job
+
+        @param pmsg Frame to send
+        @param periodUs Period in microseconds
+        @param delayUs Delay before first send in microseconds
+        @param count Number of sends, zero is forever
+        @return Job id (>0) on success, zero on failure
+    */
+    uint32_t add(const canalMsg *pmsg,
+                    uint64_t periodUs,
+                    uint64_t delayUs = 0,
+                    uint32_t count = 0);
+
+    /*!
+        Update frame and/or period of a job. The new frame is used
+        from the next deadline on.
+
+        @param id Job id
+        @param pmsg New frame or NULL to keep the current
+        @param periodUs New period or zero to keep the current
+        @return CANAL_ERROR_SUCCESS on success, CANAL error code on failure
+    */
+    int update(uint32_t id, const canalMsg *pmsg, uint64_t periodUs = 0);
+
+    /*!
+        Remove a job
+
+        @param id Job id
+        @return CANAL_ERROR_SUCCESS on success, CANAL error code on failure
+    */
+    int remove(uint32_t id);
+
+    /*!
+        Remove all jobs and stop the scheduler thread
+    */
+    void stop(void);
+
+    /*!
+        Get statistics for a job
+
+        @param id Job id
+        @param pstat Receives statistics
+        @return CANAL_ERROR_SUCCESS on success, CANAL error code on failure
+    */
+    int getStatistics(uint32_t id, cyclicStatistics *pstat);
+
+private:
+
+    typedef std::chrono::steady_clock clock;
+
+    // A scheduled frame
+    typedef struct {
+        canalMsg msg;
+        uint64_t periodUs;
+        uint32_t remaining;             // Sends left, zero is forever
+        clock::time_point deadline;     // Next absolute deadline
+        cyclicStatistics stat;
+        double sumJitterUs;
+    } cyclicJob;
+
+    // Deadline queue entry
+    typedef std::pair<clock::time_point, uint32_t> deadlineEntry;
+
+    // Scheduler thread
+    void workThread(void);
+
+    // CANAL interface to send on
+    CCanalIf *m_pif;
+
+    // Protects everything below
+    std::mutex m_mutex;
+
+    // Signalled when a job is added or the thread should quit
+    std::condition_variable m_cv;
+
+    // Jobs by id
+    std::map<uint32_t, cyclicJob> m_jobs;
+
+    // Earliest deadline first. Stale entries for removed or
+    // rescheduled jobs are skipped when popped.
+    std::priority_queue<deadlineEntry,
+                        std::vector<deadlineEntry>,
+                        std::greater<deadlineEntry>> m_deadlines;
+
+    // Next job id
+    uint32_t m_nextId;
+
+    bool m_bQuit;
+    std::thread m_thread;
+};
+
+#endif
@@ -0,0 +1,717 @@
+///////////////////////////////////////////////////////////////////////////
+// dbc.cpp
+//
+// DBC database. Messages are compiled into extraction plans so
+// signals can be decoded in the receive thread.
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <fstream>
+#include <sstream>
+
+#include "dbc.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// makePlan
+//
+// Precompute shift and mask. Intel signals are taken from the frame
+// data read as a little endian word, Motorola signals from the data
+// read as a big endian word. Returns false if the signal doesn't fit
+// in eight bytes.
+//
+
+static bool
+makePlan(dbcSignal *psig)
+{
+    if ((0 == psig->length) || (psig->length > 64) || (psig->startBit > 63)) {
+        return false;
+    }
+
+    psig->mask = (64 == psig->length) ?
+                    ~(uint64_t)0 : (((uint64_t)1 << psig->length) - 1);
+
+    if (psig->bLittleEndian) {
+        if ((psig->startBit + psig->length) > 64) {
+            return false;
+        }
+        psig->shift = psig->startBit;
+        psig->bytes = (psig->startBit + psig->length - 1) / 8 + 1;
+    }
+    else {
+        // Start bit is the msb, bit 7 of a byte is its msb
+        uint32_t msb = (psig->startBit / 8) * 8 + (7 - (psig->startBit % 8));
+        uint32_t lsb = msb + psig->length - 1;
+        if (lsb > 63) {
+            return false;
+        }
+        psig->shift = 63 - lsb;
+        psig->bytes = lsb / 8 + 1;
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// parseMessage
+//
+// BO_ <id> <name>: <dlc> <sender>
+// prawId receives the id as written, flags included.
+//
+
+static bool
+parseMessage(const std::string &line, dbcMessage *pmessage, unsigned long *prawId)
+{
+    std::istringstream iss(line);
+    std::string tag;
+    unsigned long id;
+    std::string name;
+
+    if (!(iss >> tag >> id >> name)) {
+        return false;
+    }
+
+    if (':' == name.back()) {
+        name.pop_back();
+    }
+    else {
+        std::string colon;
+        if (!(iss >> colon) || (":" != colon)) {
+            return false;
+        }
+    }
+
+    if (!(iss >> pmessage->dlc) || name.empty()) {
+        return false;
+    }
+
+    *prawId             = id;
+    pmessage->id        = id & 0x1fffffff;
+    pmessage->bExtended = (0 != (id & DBC_ID_EXTENDED));
+    pmessage->name      = name;
+    pmessage->mux       = -1;
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// parseSignal
+//
+// SG_ <name> [M|m<n>] : <start>|<length>@<order><sign> (<factor>,<offset>)
+//      [<min>|<max>] "<unit>" <receivers>
+//
+
+static bool
+parseSignal(const std::string &line, dbcSignal *psig)
+{
+    size_t colon = line.find(':');
+    if (std::string::npos == colon) {
+        return false;
+    }
+
+    std::istringstream iss(line.substr(0, colon));
+    std::string tag;
+    std::string mux;
+
+    if (!(iss >> tag >> psig->name)) {
+        return false;
+    }
+
+    psig->muxType  = DBC_MUX_NONE;
+    psig->muxValue = 0;
+    if (iss >> mux) {
+        if ("M" == mux) {
+            psig->muxType = DBC_MUX_SWITCH;
+        }
+        else if (('m' == mux[0]) && (mux.size() > 1)) {
+            // Extended multiplexing (m<n>M) is taken as m<n>
+            psig->muxType  = DBC_MUX_VALUE;
+            psig->muxValue = (uint32_t)strtoul(mux.c_str() + 1, NULL, 10);
+        }
+        else {
+            return false;
+        }
+    }
+
+    unsigned int start, length;
+    char order, sign;
+    int pos = 0;
+    if (8 != sscanf(line.c_str() + colon + 1,
+                        " %u|%u@%c%c (%lf,%lf) [%lf|%lf]%n",
+                        &start, &length, &order, &sign,
+                        &psig->factor, &psig->offset,
+                        &psig->min, &psig->max, &pos) ||
+        (0 == pos)) {
+        return false;
+    }
+
+    if ((('0' != order) && ('1' != order)) ||
+        (('+' != sign) && ('-' != sign))) {
+        return false;
+    }
+
+    psig->startBit      = start;
+    psig->length        = length;
+    psig->bLittleEndian = ('1' == order);
+    psig->bSigned       = ('-' == sign);
+    psig->valueType     = DBC_VALUE_INTEGER;
+
+    // Unit
+    psig->unit.clear();
+    size_t q1 = line.find('"', colon + 1 + pos);
+    if (std::string::npos != q1) {
+        size_t q2 = line.find('"', q1 + 1);
+        if (std::string::npos != q2) {
+            psig->unit = line.substr(q1 + 1, q2 - q1 - 1);
+        }
+    }
+
+    return makePlan(psig);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// constructor
+//
+
+CDbc::CDbc()
+{
+    m_bLoaded = false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// deconstructor
+//
+
+CDbc::~CDbc()
+{
+    ;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// load
+//
+
+int
+CDbc::load(const std::string &path, std::string &strError)
+{
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        strError = "Unable to open " + path;
+        return CANAL_ERROR_PARAMETER;
+    }
+
+    std::shared_ptr<dbcDatabase> pdb = std::make_shared<dbcDatabase>();
+    dbcMessage *pmessage = NULL;
+    std::string line;
+    uint32_t lineno = 0;
+
+    while (std::getline(file, line)) {
+
+        lineno++;
+
+        size_t first = line.find_first_not_of(" \t\r");
+        if (std::string::npos == first) {
+            pmessage = NULL;    // Blank line ends a message
+            continue;
+        }
+
+        std::string where = path + ":" + std::to_string(lineno) + ": ";
+
+        if (0 == line.compare(first, 4, "BO_ ")) {
+            dbcMessage message;
+            unsigned long rawId;
+            if (!parseMessage(line.substr(first), &message, &rawId)) {
+                strError = where + "Invalid message";
+                return CANAL_ERROR_PARAMETER;
+            }
+
+            // Pseudo message for signals not in any message
+            if (DBC_ID_INDEPENDENT == rawId) {
+                pmessage = NULL;
+                continue;
+            }
+
+            uint32_t key = messageKey(message.id, message.bExtended);
+            if (pdb->byId.count(key)) {
+                strError = where + "Duplicate message id";
+                return CANAL_ERROR_PARAMETER;
+            }
+
+            pdb->byId[key] = (uint32_t)pdb->messages.size();
+            pdb->byName[message.name] = (uint32_t)pdb->messages.size();
+            pdb->messages.push_back(message);
+            pmessage = &pdb->messages.back();
+        }
+        else if (0 == line.compare(first, 4, "SG_ ")) {
+            if (NULL == pmessage) {
+                continue;
+            }
+
+            dbcSignal sig;
+            if (!parseSignal(line.substr(first), &sig)) {
+                strError = where + "Invalid signal";
+                return CANAL_ERROR_PARAMETER;
+            }
+
+            if (DBC_MUX_SWITCH == sig.muxType) {
+                if (pmessage->mux >= 0) {
+                    strError = where + "More than one multiplexor";
+                    return CANAL_ERROR_PARAMETER;
+                }
+                pmessage->mux = (int32_t)pmessage->signals.size();
+            }
+
+            pmessage->byName[sig.name] = (uint32_t)pmessage->signals.size();
+            pmessage->signals.push_back(sig);
+        }
+        else if (0 == line.compare(first, 13, "SIG_VALTYPE_ ")) {
+            // SIG_VALTYPE_ <id> <signal> : <1|2>;
+            std::istringstream iss(line.substr(first));
+            std::string tag, name, colon;
+            unsigned long id;
+            int type;
+            if (!(iss >> tag >> id >> name)) {
+                continue;
+            }
+            if (':' == name.back()) {
+                name.pop_back();
+            }
+            else {
+                iss >> colon;
+            }
+            if (!(iss >> type)) {
+                continue;
+            }
+
+            auto it = pdb->byId.find(messageKey((uint32_t)id, (0 != (id & DBC_ID_EXTENDED))));
+            if (pdb->byId.end() == it) {
+                continue;
+            }
+
+            for (dbcSignal &sig : pdb->messages[it->second].signals) {
+                if (sig.name != name) {
+                    continue;
+                }
+                if (((1 == type) && (32 != sig.length)) ||
+                    ((2 == type) && (64 != sig.length))) {
+                    strError = where + "Float signal of wrong length";
+                    return CANAL_ERROR_PARAMETER;
+                }
+                sig.valueType = (1 == type) ? DBC_VALUE_FLOAT : DBC_VALUE_DOUBLE;
+            }
+        }
+        else {
+            pmessage = NULL;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    applyFilter(pdb.get(), m_filter);
+    m_pdb = pdb;
+    m_bLoaded = true;
+
+    return CANAL_ERROR_SUCCESS;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// unload
+//
+
+void
+CDbc::unload(void)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_pdb.reset();
+    m_bLoaded = false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// setSignalFilter
+//
+
+void
+CDbc::setSignalFilter(const std::vector<std::string> &names)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_filter = names;
+
+    // Published databases are never changed, make a new one
+    if (m_pdb) {
+        std::shared_ptr<dbcDatabase> pdb = std::make_shared<dbcDatabase>(*m_pdb);
+        applyFilter(pdb.get(), m_filter);
+        m_pdb = pdb;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getDatabase
+//
+
+std::shared_ptr<const dbcDatabase>
+CDbc::getDatabase(void)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_pdb;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// applyFilter
+//
+
+void
+CDbc::applyFilter(dbcDatabase *pdb, const std::vector<std::string> &filter)
+{
+    for (dbcMessage &message : pdb->messages) {
+        message.selected.clear();
+        for (uint32_t i = 0; i < message.signals.size(); i++) {
+            bool bWanted = filter.empty();
+            for (const std::string &name : filter) {
+                if ((name == message.signals[i].name) ||
+                    (name == (message.name + "." + message.signals[i].name))) {
+                    bWanted = true;
+                    break;
+                }
+            }
+            if (bWanted) {
+                message.selected.push_back(i);
+            }
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// findMessage
+//
+
+const dbcMessage *
+CDbc::findMessage(const dbcDatabase *pdb, const canalMsg *pmsg)
+{
+    if ((NULL == pdb) || (pmsg->flags & CANAL_IDFLAG_STATUS)) {
+        return NULL;
+    }
+
+    auto it = pdb->byId.find(messageKey(pmsg->id,
+                                (0 != (pmsg->flags & CANAL_IDFLAG_EXTENDED))));
+    if (pdb->byId.end() == it) {
+        return NULL;
+    }
+
+    return &pdb->messages[it->second];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// findMessage
+//
+
+const dbcMessage *
+CDbc::findMessage(const dbcDatabase *pdb, const std::string &name)
+{
+    if (NULL == pdb) {
+        return NULL;
+    }
+
+    auto it = pdb->byName.find(name);
+    if (pdb->byName.end() == it) {
+        return NULL;
+    }
+
+    return &pdb->messages[it->second];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// findMessage
+//
+
+const dbcMessage *
+CDbc::findMessage(const dbcDatabase *pdb, uint32_t id)
+{
+    if (NULL == pdb) {
+        return NULL;
+    }
+
+    auto it = pdb->byId.find(messageKey(id, false));
+    if ((pdb->byId.end() == it) || (id > 0x7ff)) {
+        it = pdb->byId.find(messageKey(id, true));
+    }
+    if (pdb->byId.end() == it) {
+        return NULL;
+    }
+
+    return &pdb->messages[it->second];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// rawValue
+//
+
+static inline uint64_t
+rawValue(const dbcSignal *psig, uint64_t le, uint64_t be)
+{
+    return ((psig->bLittleEndian ? le : be) >> psig->shift) & psig->mask;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// decode
+//
+
+void
+CDbc::decode(const dbcMessage *pmessage, const canalMsg *pmsg, double *pvalues)
+{
+    uint32_t size = (pmsg->sizeData > 8) ? 8 : pmsg->sizeData;
+
+    // The frame as little and big endian words
+    uint64_t le = 0;
+    uint64_t be = 0;
+    for (uint32_t i = 0; i < size; i++) {
+        le |= (uint64_t)pmsg->data[i] << (8 * i);
+        be |= (uint64_t)pmsg->data[i] << (56 - 8 * i);
+    }
+
+    // Multiplexor value
+    bool bMux = false;
+    uint64_t mux = 0;
+    if (pmessage->mux >= 0) {
+        const dbcSignal *psig = &pmessage->signals[pmessage->mux];
+        if (psig->bytes <= size) {
+            bMux = true;
+            mux = rawValue(psig, le, be);
+        }
+    }
+
+    for (uint32_t idx : pmessage->selected) {
+
+        const dbcSignal *psig = &pmessage->signals[idx];
+
+        if ((psig->bytes > size) ||
+            ((DBC_MUX_VALUE == psig->muxType) &&
+                (!bMux || (mux != psig->muxValue)))) {
+            *pvalues++ = NAN;
+            continue;
+        }
+
+        uint64_t raw = rawValue(psig, le, be);
+        double value;
+
+        if (DBC_VALUE_FLOAT == psig->valueType) {
+            uint32_t bits = (uint32_t)raw;
+            float f;
+            memcpy(&f, &bits, sizeof(f));
+            value = f;
+        }
+        else if (DBC_VALUE_DOUBLE == psig->valueType) {
+            memcpy(&value, &raw, sizeof(value));
+        }
+        else if (psig->bSigned && (psig->length < 64) &&
+                    (raw & ((uint64_t)1 << (psig->length - 1)))) {
+            value = (double)(int64_t)(raw | ~psig->mask);
+        }
+        else if (psig->bSigned) {
+            value = (double)(int64_t)raw;
+        }
+        else {
+            value = (double)raw;
+        }
+
+        *pvalues++ = value * psig->factor + psig->offset;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// toRaw
+//
+// Physical value to raw bits. Returns false if out of range.
+//
+
+static bool
+toRaw(const dbcSignal *psig, double value, uint64_t *praw)
+{
+    // [0|0] means no range given
+    if (((0 != psig->min) || (0 != psig->max)) &&
+        ((value < psig->min) || (value > psig->max))) {
+        return false;
+    }
+
+    if (DBC_VALUE_FLOAT == psig->valueType) {
+        float f = (float)((value - psig->offset) / psig->factor);
+        uint32_t bits;
+        memcpy(&bits, &f, sizeof(bits));
+        *praw = bits;
+        return true;
+    }
+
+    if (DBC_VALUE_DOUBLE == psig->valueType) {
+        double d = (value - psig->offset) / psig->factor;
+        memcpy(praw, &d, sizeof(d));
+        return true;
+    }
+
+    if (0 == psig->factor) {
+        return false;
+    }
+
+    double raw = round((value - psig->offset) / psig->factor);
+
+    // Exclusive upper bounds. 2^63 - 1 and 2^64 - 1 are not exact
+    // in a double and would round up to a value that overflows.
+    if (psig->bSigned) {
+        double lo = -ldexp(1, psig->length - 1);
+        double hi = ldexp(1, psig->length - 1);
+        if (!((raw >= lo) && (raw < hi))) {
+            return false;
+        }
+        *praw = (uint64_t)(int64_t)raw & psig->mask;
+    }
+    else {
+        if (!((raw >= 0) && (raw < ldexp(1, psig->length)))) {
+            return false;
+        }
+        *praw = (uint64_t)raw & psig->mask;
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// encode
+//
+
+int
+CDbc::encode(const dbcMessage *pmessage,
+                const double *pvalues,
+                canalMsg *pmsg,
+                std::string &strError)
+{
+    // Multiplexor value, given or from the multiplexed signals
+    bool bMux = false;
+    double mux = 0;
+    if (pmessage->mux >= 0) {
+        if (!isnan(pvalues[pmessage->mux])) {
+            bMux = true;
+            mux = pvalues[pmessage->mux];
+        }
+        for (uint32_t i = 0; !bMux && (i < pmessage->signals.size()); i++) {
+            if ((DBC_MUX_VALUE == pmessage->signals[i].muxType) && !isnan(pvalues[i])) {
+                const dbcSignal *psig = &pmessage->signals[pmessage->mux];
+                bMux = true;
+                mux = pmessage->signals[i].muxValue * psig->factor + psig->offset;
+            }
+        }
+    }
+
+    uint64_t le = 0;
+    uint64_t be = 0;
+    uint64_t muxRaw = 0;
+
+    for (uint32_t i = 0; i < pmessage->signals.size(); i++) {
+
+        const dbcSignal *psig = &pmessage->signals[i];
+        double value = pvalues[i];
+
+        if ((int32_t)i == pmessage->mux) {
+            value = mux;
+        }
+        else if (isnan(value)) {
+            continue;
+        }
+
+        uint64_t raw;
+        if (!toRaw(psig, value, &raw)) {
+            strError = "Signal " + psig->name + " out of range";
+            return CANAL_ERROR_PARAMETER;
+        }
+
+        if ((int32_t)i == pmessage->mux) {
+            muxRaw = raw;
+        }
+
+        if (psig->bLittleEndian) {
+            le |= raw << psig->shift;
+        }
+        else {
+            be |= raw << psig->shift;
+        }
+    }
+
+    // Multiplexed signals must belong to the multiplexor value
+    for (uint32_t i = 0; i < pmessage->signals.size(); i++) {
+        const dbcSignal *psig = &pmessage->signals[i];
+        if ((DBC_MUX_VALUE == psig->muxType) && !isnan(pvalues[i]) &&
+            (muxRaw != psig->muxValue)) {
+            strError = "Signal " + psig->name + " is not sent with multiplexor value " +
+                            std::to_string(muxRaw);
+            return CANAL_ERROR_PARAMETER;
+        }
+    }
+
+    memset(pmsg, 0, sizeof(canalMsg));
+    pmsg->id = pmessage->id;
+    pmsg->flags = pmessage->bExtended ? CANAL_IDFLAG_EXTENDED : 0;
+    pmsg->sizeData = (pmessage->dlc > 8) ? 8 : pmessage->dlc;
+    for (uint32_t i = 0; i < 8; i++) {
+        pmsg->data[i] = (uint8_t)(le >> (8 * i)) | (uint8_t)(be >> (56 - 8 * i));
+    }
+
+    return CANAL_ERROR_SUCCESS;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// decode
+//
+
+void
+CDbc::decode(const canalMsg *pmsgs, size_t cnt, dbcDecoded *pdecoded)
+{
+    pdecoded->pdb = getDatabase();
+    pdecoded->values.clear();
+    pdecoded->offset.resize(cnt + 1);
+    pdecoded->message.resize(cnt);
+
+    const dbcDatabase *pdb = pdecoded->pdb.get();
+
+    for (size_t i = 0; i < cnt; i++) {
+
+        pdecoded->offset[i] = (uint32_t)pdecoded->values.size();
+        pdecoded->message[i] = -1;
+
+        const dbcMessage *pmessage = findMessage(pdb, &pmsgs[i]);
+        if ((NULL == pmessage) || pmessage->selected.empty()) {
+            continue;
+        }
+
+        pdecoded->message[i] = (int32_t)(pmessage - pdb->messages.data());
+
+        size_t pos = pdecoded->values.size();
+        pdecoded->values.resize(pos + pmessage->selected.size());
+        decode(pmessage, &pmsgs[i], pdecoded->values.data() + pos);
+    }
+
+    pdecoded->offset[cnt] = (uint32_t)pdecoded->values.size();
+}
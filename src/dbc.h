@@ -0,0 +1,251 @@
+///////////////////////////////////////////////////////////////////////////
+// dbc.h
+//
+// DBC database. Messages are compiled into extraction plans so
+// signals can be decoded in the receive thread.
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#if !defined(DBC_H)
+#define DBC_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "canal.h"
+
+// Multiplexing of a signal
+#define DBC_MUX_NONE        0       // Always present
+#define DBC_MUX_SWITCH      1       // Multiplexor (M)
+#define DBC_MUX_VALUE       2       // Present for one multiplexor value (m<n>)
+
+// Raw value type (SIG_VALTYPE_)
+#define DBC_VALUE_INTEGER   0
+#define DBC_VALUE_FLOAT     1
+#define DBC_VALUE_DOUBLE    2
+
+// Id flag for extended frames, as in DBC files
+#define DBC_ID_EXTENDED     0x80000000
+
+// Id of the VECTOR__INDEPENDENT_SIG_MSG pseudo message
+#define DBC_ID_INDEPENDENT  0xc0000000
+
+/*!
+    A signal and its extraction plan
+*/
+typedef struct structDbcSignal {
+    std::string name;
+    std::string unit;
+    uint32_t startBit;                  // As given in the DBC file
+    uint32_t length;                    // Number of bits
+    bool bLittleEndian;                 // Intel (@1) or Motorola (@0)
+    bool bSigned;
+    uint8_t valueType;                  // DBC_VALUE_x
+    double factor;
+    double offset;
+    double min;
+    double max;
+    uint8_t muxType;                    // DBC_MUX_x
+    uint32_t muxValue;                  // Multiplexor value for DBC_MUX_VALUE
+
+    // Extraction plan
+    uint32_t shift;                     // Right shift of the 64-bit frame word
+    uint64_t mask;                      // Mask after shift
+    uint32_t bytes;                     // Frame data bytes needed
+} dbcSignal;
+
+/*!
+    A message and the signals it carry
+*/
+typedef struct structDbcMessage {
+    uint32_t id;                        // Id without DBC_ID_EXTENDED
+    bool bExtended;
+    std::string name;
+    uint32_t dlc;
+    std::vector<dbcSignal> signals;
+    int32_t mux;                        // Index of multiplexor or -1
+    std::vector<uint32_t> selected;     // Signals decoded, in output order
+    std::unordered_map<std::string, uint32_t> byName;   // Signal index
+} dbcMessage;
+
+/*!
+    A loaded database. Never changed once published so the receive
+    thread can use it without locking.
+*/
+typedef struct structDbcDatabase {
+    std::vector<dbcMessage> messages;
+    std::unordered_map<uint32_t, uint32_t> byId;            // Key -> index
+    std::unordered_map<std::string, uint32_t> byName;       // Name -> index
+} dbcDatabase;
+
+/*!
+    Signals decoded from a batch of frames
+*/
+typedef struct structDbcDecoded {
+    std::shared_ptr<const dbcDatabase> pdb;     // Database decoded with
+    std::vector<double> values;                 // Values of all frames
+    std::vector<uint32_t> offset;               // First value of frame n, n+1 items
+    std::vector<int32_t> message;               // Message of frame n or -1
+} dbcDecoded;
+
+class CDbc {
+
+public:
+
+    CDbc();
+    ~CDbc();
+
+    /*!
+        Load a DBC file. Replaces a loaded database.
+
+        @param path Path to DBC file
+        @param strError Receives a description of what was wrong
+        @return CANAL_ERROR_SUCCESS on success, CANAL_ERROR_PARAMETER
+                    on failure.
+    */
+    int load(const std::string &path, std::string &strError);
+
+    /*!
+        Drop the loaded database
+    */
+    void unload(void);
+
+    /*!
+        Select signals to decode. Also applied to databases loaded
+        later.
+
+        @param names Signal names, "signal" or "message.signal".
+                    Empty to decode all signals.
+    */
+    void setSignalFilter(const std::vector<std::string> &names);
+
+    /*!
+        Get the loaded database
+
+        @return Database or an empty pointer if none is loaded
+    */
+    std::shared_ptr<const dbcDatabase> getDatabase(void);
+
+    bool isLoaded(void) { return m_bLoaded; };
+
+    /*!
+        Key for a message in dbcDatabase::byId
+
+        @param id Frame id
+        @param bExtended True for an extended id
+        @return Key
+    */
+    static uint32_t messageKey(uint32_t id, bool bExtended)
+        { return ((id & 0x1fffffff) | (bExtended ? DBC_ID_EXTENDED : 0)); };
+
+    /*!
+        Find the message of a frame
+
+        @param pdb Database
+        @param pmsg Frame
+        @return Message or NULL
+    */
+    static const dbcMessage *findMessage(const dbcDatabase *pdb, const canalMsg *pmsg);
+
+    /*!
+        Decode the selected signals of a frame. Signals not in the
+        frame (short frame, other multiplexor value) are NaN.
+
+        @param pmessage Message of the frame
+        @param pmsg Frame
+        @param pvalues Receives pmessage->selected.size() values
+    */
+    static void decode(const dbcMessage *pmessage, const canalMsg *pmsg, double *pvalues);
+
+    /*!
+        Find a message by name
+
+        @param pdb Database
+        @param name Message name
+        @return Message or NULL
+    */
+    static const dbcMessage *findMessage(const dbcDatabase *pdb, const std::string &name);
+
+    /*!
+        Find a message by id
+
+        @param pdb Database
+        @param id Frame id. Ids above 0x7ff are taken as extended
+                    unless there is a message with the standard id.
+        @return Message or NULL
+    */
+    static const dbcMessage *findMessage(const dbcDatabase *pdb, uint32_t id);
+
+    /*!
+        Build a frame from physical values. Signals not given are
+        zero. The multiplexor is taken from the multiplexed signals
+        given if it is not given itself.
+
+        @param pmessage Message to build
+        @param pvalues One value per signal in pmessage->signals,
+                    NaN for signals not given
+        @param pmsg Receives the frame
+        @param strError Receives a description of what was wrong
+        @return CANAL_ERROR_SUCCESS on success, CANAL_ERROR_PARAMETER
+                    if a value is out of range or doesn't belong to
+                    the multiplexor value.
+    */
+    static int encode(const dbcMessage *pmessage,
+                        const double *pvalues,
+                        canalMsg *pmsg,
+                        std::string &strError);
+
+    /*!
+        Decode a batch of frames
+
+        @param pmsgs Frames
+        @param cnt Number of frames
+        @param pdecoded Receives the values
+    */
+    void decode(const canalMsg *pmsgs, size_t cnt, dbcDecoded *pdecoded);
+
+private:
+
+    // Set selected signals of all messages
+    static void applyFilter(dbcDatabase *pdb, const std::vector<std::string> &filter);
+
+    // Protects m_pdb and m_filter
+    std::mutex m_mutex;
+
+    std::shared_ptr<const dbcDatabase> m_pdb;
+    std::vector<std::string> m_filter;
+
+    std::atomic<bool> m_bLoaded;
+};
+
+#endif
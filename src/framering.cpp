@@ -0,0 +1,119 @@
+///////////////////////////////////////////////////////////////////////////
+// framering.cpp
+//
+// Bounded FIFO ring of CAN frames.
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <string.h>
+
+#include "framering.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// constructor
+//
+
+CFrameRing::CFrameRing(size_t capacity)
+{
+    setCapacity(capacity);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// deconstructor
+//
+
+CFrameRing::~CFrameRing()
+{
+    ;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// setCapacity
+//
+
+void
+CFrameRing::setCapacity(size_t capacity)
+{
+    if (0 == capacity) {
+        capacity = 1;
+    }
+
+    m_buf.resize(capacity);
+    m_buf.shrink_to_fit();
+    clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// push
+//
+
+bool
+CFrameRing::push(const canalMsg *pmsg)
+{
+    if (isFull()) {
+        return false;
+    }
+
+    size_t tail = m_head + m_count;
+    if (tail >= m_buf.size()) {
+        tail -= m_buf.size();
+    }
+
+    memcpy(&m_buf[tail], pmsg, sizeof(canalMsg));
+    m_count++;
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// pop
+//
+
+size_t
+CFrameRing::pop(canalMsg *pbuf, size_t max)
+{
+    size_t cnt = (max < m_count) ? max : m_count;
+
+    // At most two contiguous copies
+    size_t first = m_buf.size() - m_head;
+    if (first > cnt) {
+        first = cnt;
+    }
+
+    memcpy(pbuf, &m_buf[m_head], first * sizeof(canalMsg));
+    if (cnt > first) {
+        memcpy(pbuf + first, &m_buf[0], (cnt - first) * sizeof(canalMsg));
+    }
+
+    m_head += cnt;
+    if (m_head >= m_buf.size()) {
+        m_head -= m_buf.size();
+    }
+    m_count -= cnt;
+
+    return cnt;
+}
@@ -0,0 +1,100 @@
+///////////////////////////////////////////////////////////////////////////
+// framering.h
+//
+// Bounded FIFO ring of CAN frames.
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#if !defined(FRAMERING_H)
+#define FRAMERING_H
+
+#include <stddef.h>
+
+#include <vector>
+
+#include "canal.h"
+
+// Default number of frames in a ring
+#define FRAMERING_DEFAULT_CAPACITY  4096
+
+/*!
+    Fixed size FIFO of frames. Storage is allocated once so
+    push/pop never allocate. Not thread safe, the owner lock it.
+*/
+class CFrameRing {
+
+public:
+
+    CFrameRing(size_t capacity = FRAMERING_DEFAULT_CAPACITY);
+    ~CFrameRing();
+
+    /*!
+        Change capacity. Frames in the ring are dropped.
+
+        @param capacity Max number of frames
+    */
+    void setCapacity(size_t capacity);
+
+    /*!
+        Add a frame at the end
+
+        @param pmsg Frame to add
+        @return False if the ring is full
+    */
+    bool push(const canalMsg *pmsg);
+
+    /*!
+        Remove frames from the front
+
+        @param pbuf Buffer receiving the frames
+        @param max Max number of frames to remove
+        @return Number of frames removed
+    */
+    size_t pop(canalMsg *pbuf, size_t max);
+
+    /*!
+        Drop all frames
+    */
+    void clear(void) { m_head = 0; m_count = 0; };
+
+    size_t size(void) { return m_count; };
+    size_t capacity(void) { return m_buf.size(); };
+    bool isEmpty(void) { return (0 == m_count); };
+    bool isFull(void) { return (m_count == m_buf.size()); };
+
+private:
+
+    std::vector<canalMsg> m_buf;
+
+    // Index of first frame
+    size_t m_head;
+
+    // Number of frames in ring
+    size_t m_count;
+};
+
+#endif
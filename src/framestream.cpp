@@ -0,0 +1,320 @@
+///////////////////////////////////////////////////////////////////////////
+// framestream.cpp
+//
+// Pull based frame stream. A reader thread fills a bounded ring
+// and JS reads batches from it.
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <string.h>
+
+#include "framestream.h"
+#include "node-canal.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// constructor
+//
+
+CFrameStream::CFrameStream()
+    : m_cntFrames(0),
+      m_cntBatches(0),
+      m_cntFull(0),
+      m_pif(NULL),
+      m_pdeferred(NULL),
+      m_bPending(false),
+      m_bRef(false),
+      m_batchSize(1),
+      m_maxLatency(500),
+      m_bColumnar(false),
+      m_timeout(500),
+      m_receiveTimeout(500),
+      m_bQuit(false),
+      m_bRunning(false) {
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// deconstructor
+//
+
+CFrameStream::~CFrameStream() {
+  quit();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// start
+//
+
+int CFrameStream::start(Napi::Env env, CCanalIf *pif, size_t capacity) {
+
+  if (m_bRunning) {
+    return CANAL_ERROR_INIT_READY;
+  }
+
+  if (NULL == pif) {
+    return CANAL_ERROR_PARAMETER;
+  }
+
+  m_pif = pif;
+  m_receiveTimeout = pif->m_config.receiveTimeout;
+  m_timeout = m_receiveTimeout;
+  m_ring.setCapacity(capacity);
+  m_batch.resize(m_ring.capacity());
+  m_bPending = false;
+  m_bQuit = false;
+
+  // Only used to get back to the JS thread
+  m_tsfn = Napi::ThreadSafeFunction::New(
+      env,
+      Napi::Function::New(env, [](const Napi::CallbackInfo &info) {}),
+      "CFrameStream",
+      0,
+      1);
+
+  // Keep the event loop alive only while a read is pending
+  m_tsfn.Unref(env);
+
+  m_bRunning = true;
+  m_thread = std::thread(&CFrameStream::workThread, this);
+
+  return CANAL_ERROR_SUCCESS;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// stop
+//
+
+void CFrameStream::stop(Napi::Env env) {
+
+  if (!m_bRunning) {
+    return;
+  }
+
+  quit();
+  m_bRunning = false;
+
+  // Hand over what is left. The next read will get the rest
+  // and then an empty batch.
+  if (NULL != m_pdeferred) {
+    resolve(env);
+  }
+
+  m_tsfn.Release();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// quit
+//
+
+void CFrameStream::quit(void) {
+  m_bQuit = true;
+  m_cvSpace.notify_all();
+  if (m_thread.joinable()) {
+    m_thread.join();
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// read
+//
+
+Napi::Promise CFrameStream::read(Napi::Env env,
+                                    uint32_t batchSize,
+                                    uint32_t maxLatency,
+                                    bool bColumnar) {
+
+  Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+
+  if (NULL != m_pdeferred) {
+    Napi::Error err = Napi::Error::New(env, "A read is already pending");
+    err.Value().Set("code", CANAL_ERROR_GENERIC);
+    deferred.Reject(err.Value());
+    return deferred.Promise();
+  }
+
+  if (0 == batchSize) {
+    batchSize = 1;
+  }
+  if (batchSize > m_batch.size()) {
+    batchSize = (uint32_t)m_batch.size();
+  }
+  if (0 == maxLatency) {
+    maxLatency = 1;
+  }
+
+  // The reader must not sleep in the driver for longer than a
+  // frame is allowed to wait
+  m_timeout = (maxLatency < m_receiveTimeout) ? maxLatency : m_receiveTimeout;
+
+  m_pdeferred = new Napi::Promise::Deferred(deferred);
+  m_batchSize = batchSize;
+  m_maxLatency = maxLatency;
+  m_bColumnar = bColumnar;
+
+  bool bReady;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    bReady = !m_bRunning || isBatchReady(clock::now());
+    m_bPending = !bReady;
+  }
+
+  if (bReady) {
+    resolve(env);
+  }
+  else {
+    m_tsfn.Ref(env);
+    m_bRef = true;
+  }
+
+  return deferred.Promise();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// isBatchReady
+//
+
+bool CFrameStream::isBatchReady(clock::time_point now) {
+
+  if (m_ring.size() >= m_batchSize) {
+    return true;
+  }
+
+  return (!m_ring.isEmpty() &&
+          ((now - m_firstArrival) >= std::chrono::milliseconds(m_maxLatency)));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// resolve
+//
+
+void CFrameStream::resolve(Napi::Env env) {
+
+  size_t cnt;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    cnt = m_ring.pop(m_batch.data(), m_batchSize);
+    m_bPending = false;
+
+    // Frames left start a new latency window
+    if (!m_ring.isEmpty()) {
+      m_firstArrival = clock::now();
+    }
+  }
+  m_cvSpace.notify_one();
+
+  Napi::Value batch;
+  if (m_bColumnar) {
+    batch = framesToColumns(env, m_batch.data(), cnt);
+  }
+  else {
+    Napi::Array arr = Napi::Array::New(env, cnt);
+    for (size_t i = 0; i < cnt; i++) {
+      arr[uint32_t(i)] = msgToObject(env, &m_batch[i]);
+    }
+    batch = arr;
+  }
+
+  if (cnt) {
+    m_cntBatches++;
+  }
+
+  Napi::Promise::Deferred *pdeferred = m_pdeferred;
+  m_pdeferred = NULL;
+
+  // Only reads that waited took a reference
+  if (m_bRef) {
+    m_tsfn.Unref(env);
+    m_bRef = false;
+  }
+
+  pdeferred->Resolve(batch);
+  delete pdeferred;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// deliverCallback
+//
+
+void CFrameStream::deliverCallback(Napi::Env env,
+                                      Napi::Function jsCallback,
+                                      CFrameStream *pstream) {
+
+  // May have been resolved by stop() in the meantime
+  if (NULL == pstream->m_pdeferred) {
+    return;
+  }
+
+  pstream->resolve(env);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// workThread
+//
+
+void CFrameStream::workThread(void) {
+
+  canalMsg msg;
+
+  rtApplyTuning(&m_pif->m_tuning);
+
+  while (!m_bQuit && !m_pif->m_bQuit) {
+
+    // Stop pulling from the driver while the ring is full
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      if (m_ring.isFull()) {
+        m_cntFull++;
+        m_cvSpace.wait(lock, [this] { return m_bQuit || !m_ring.isFull(); });
+        continue;
+      }
+    }
+
+    // Sit and wait for connection if were not connected
+    if (0 == m_pif->m_openHandle) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      continue;
+    }
+
+    int rv = m_pif->receive(&msg, m_timeout);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    clock::time_point now = clock::now();
+
+    if (CANAL_ERROR_SUCCESS == rv) {
+      if (m_ring.isEmpty()) {
+        m_firstArrival = now;
+      }
+      m_ring.push(&msg);
+      m_cntFrames++;
+    }
+
+    if (m_bPending && isBatchReady(now)) {
+      m_bPending = false;
+      m_tsfn.NonBlockingCall(this, deliverCallback);
+    }
+  }
+}
@@ -0,0 +1,179 @@
+///////////////////////////////////////////////////////////////////////////
+// framestream.h
+//
+// Pull based frame stream. A reader thread fills a bounded ring
+// and JS reads batches from it.
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#if !defined(FRAMESTREAM_H)
+#define FRAMESTREAM_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <napi.h>
+
+#include "canalif.h"
+#include "framering.h"
+
+/*!
+    Frames are read from the driver into a bounded ring by a native
+    thread and handed to JS in batches through read(). When JS stops
+    reading the ring fills up and the thread stops pulling frames
+    from the driver, so backpressure ends up in the driver fifo.
+
+    A read is resolved when batchSize frames are buffered or when
+    the oldest buffered frame has waited maxLatency milliseconds.
+    An empty batch means the stream has been stopped.
+
+    All methods except the thread itself run on the JS thread.
+*/
+class CFrameStream {
+
+public:
+
+    CFrameStream();
+    ~CFrameStream();
+
+    /*!
+        Start the reader thread
+
+        @param env Environment of the caller
+        @param pif CANAL interface to read from
+        @param capacity Max number of buffered frames
+        @return CANAL_ERROR_SUCCESS on success
+    */
+    int start(Napi::Env env, CCanalIf *pif, size_t capacity);
+
+    /*!
+        Stop the reader thread. A pending read is resolved with
+        the frames left in the ring.
+
+        @param env Environment of the caller
+    */
+    void stop(Napi::Env env);
+
+    /*!
+        Stop the reader thread without touching JS. Used when the
+        environment is torn down.
+    */
+    void quit(void);
+
+    /*!
+        Read a batch of frames
+
+        @param env Environment of the caller
+        @param batchSize Max number of frames in the batch
+        @param maxLatency Max time in milliseconds a frame is held back
+        @param bColumnar True to resolve with columns (see
+                    framesToColumns) instead of an array of frames
+        @return Promise resolved with an array of frames
+    */
+    Napi::Promise read(Napi::Env env,
+                        uint32_t batchSize,
+                        uint32_t maxLatency,
+                        bool bColumnar = false);
+
+    bool isRunning(void) { return m_bRunning; };
+
+    // Frames read from the driver
+    std::atomic<uint32_t> m_cntFrames;
+
+    // Batches delivered to JS
+    std::atomic<uint32_t> m_cntBatches;
+
+    // Times the reader paused because the ring was full
+    std::atomic<uint32_t> m_cntFull;
+
+private:
+
+    typedef std::chrono::steady_clock clock;
+
+    // Reader thread
+    void workThread(void);
+
+    // Check if the pending read can be resolved. Lock must be held.
+    bool isBatchReady(clock::time_point now);
+
+    // Pop a batch and resolve the pending read. JS thread only.
+    void resolve(Napi::Env env);
+
+    // Called on the JS thread when the reader has a batch ready
+    static void deliverCallback(Napi::Env env,
+                                    Napi::Function jsCallback,
+                                    CFrameStream *pstream);
+
+    CCanalIf *m_pif;
+
+    // Protects ring and pending read
+    std::mutex m_mutex;
+
+    // Signaled when there is room in the ring
+    std::condition_variable m_cvSpace;
+
+    CFrameRing m_ring;
+
+    // Arrival time of the oldest frame in the ring
+    clock::time_point m_firstArrival;
+
+    // Pending read, NULL if none
+    Napi::Promise::Deferred *m_pdeferred;
+
+    // True when the reader should signal the pending read
+    bool m_bPending;
+
+    // True when the pending read keeps the event loop alive
+    bool m_bRef;
+
+    uint32_t m_batchSize;
+    uint32_t m_maxLatency;
+    bool m_bColumnar;
+
+    // Receive timeout used by the reader (ms)
+    std::atomic<uint32_t> m_timeout;
+
+    // Longest receive timeout, from the interface configuration (ms)
+    uint32_t m_receiveTimeout;
+
+    // Batch being built for JS
+    std::vector<canalMsg> m_batch;
+
+    std::thread m_thread;
+    std::atomic<bool> m_bQuit;
+    bool m_bRunning;
+
+    Napi::ThreadSafeFunction m_tsfn;
+};
+
+#endif
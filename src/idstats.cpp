@@ -0,0 +1,268 @@
+///////////////////////////////////////////////////////////////////////////
+// idstats.cpp
+//
+// Per id traffic statistics kept by the receive threads.
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <math.h>
+#include <string.h>
+
+#include "idstats.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// hashId
+//
+
+static inline uint32_t
+hashId(uint32_t id)
+{
+    // Multiplicative hash, the low bits of CAN ids are often similar
+    return (id * 2654435761u) >> 8;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// constructor
+//
+
+CIdStatistics::CIdStatistics()
+{
+    reset();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// deconstructor
+//
+
+CIdStatistics::~CIdStatistics()
+{
+    ;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// reset
+//
+
+void
+CIdStatistics::reset(void)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// clear
+//
+
+void
+CIdStatistics::clear(void)
+{
+    m_standard.assign(2048, entry());
+    memset(m_standard.data(), 0, m_standard.size() * sizeof(entry));
+
+    m_extended.assign(IDSTATS_HASH_INITIAL, entry());
+    memset(m_extended.data(), 0, m_extended.size() * sizeof(entry));
+
+    m_cntExtended = 0;
+    m_cntOverflow = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// update
+//
+
+void
+CIdStatistics::update(entry *pentry, uint32_t timestamp)
+{
+    if (pentry->count) {
+        // Unsigned difference handles timestamp wrap
+        uint32_t period = timestamp - pentry->lastTimestamp;
+        if ((1 == pentry->count) || (period < pentry->minPeriod)) {
+            pentry->minPeriod = period;
+        }
+        if (period > pentry->maxPeriod) {
+            pentry->maxPeriod = period;
+        }
+        pentry->sumPeriod += period;
+        pentry->sumSqPeriod += (double)period * period;
+    }
+
+    pentry->lastTimestamp = timestamp;
+    pentry->count++;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// grow
+//
+
+void
+CIdStatistics::grow(void)
+{
+    std::vector<entry> old;
+    old.swap(m_extended);
+
+    m_extended.assign(old.size() * 2, entry());
+    memset(m_extended.data(), 0, m_extended.size() * sizeof(entry));
+
+    uint32_t mask = (uint32_t)m_extended.size() - 1;
+    for (const entry &e : old) {
+        if (0 == e.key) {
+            continue;
+        }
+        uint32_t idx = hashId(e.key - 1) & mask;
+        while (0 != m_extended[idx].key) {
+            idx = (idx + 1) & mask;
+        }
+        m_extended[idx] = e;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// lookup
+//
+
+CIdStatistics::entry *
+CIdStatistics::lookup(uint32_t id)
+{
+    uint32_t key = id + 1;
+    uint32_t mask = (uint32_t)m_extended.size() - 1;
+    uint32_t idx = hashId(id) & mask;
+
+    while (0 != m_extended[idx].key) {
+        if (key == m_extended[idx].key) {
+            return &m_extended[idx];
+        }
+        idx = (idx + 1) & mask;
+    }
+
+    // New id. Keep the load at most one half.
+    if (m_cntExtended >= IDSTATS_HASH_MAX) {
+        return NULL;
+    }
+
+    if (2 * (m_cntExtended + 1) > m_extended.size()) {
+        grow();
+        return lookup(id);
+    }
+
+    m_cntExtended++;
+    m_extended[idx].key = key;
+    return &m_extended[idx];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// add
+//
+
+void
+CIdStatistics::add(const canalMsg *pmsg)
+{
+    if (pmsg->flags & CANAL_IDFLAG_STATUS) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (!(pmsg->flags & CANAL_IDFLAG_EXTENDED)) {
+        update(&m_standard[pmsg->id & 0x7ff], pmsg->timestamp);
+        return;
+    }
+
+    entry *pentry = lookup(pmsg->id & 0x1fffffff);
+    if (NULL == pentry) {
+        m_cntOverflow++;
+        return;
+    }
+
+    update(pentry, pmsg->timestamp);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// toStatistics
+//
+
+void
+CIdStatistics::toStatistics(const entry *pentry, idStatistics *pstat)
+{
+    pstat->count = pentry->count;
+    pstat->minPeriodUs = pentry->minPeriod;
+    pstat->maxPeriodUs = pentry->maxPeriod;
+
+    uint64_t cntPeriods = pentry->count - 1;
+    if (cntPeriods && (pentry->sumPeriod > 0)) {
+        double avg = pentry->sumPeriod / cntPeriods;
+        double var = pentry->sumSqPeriod / cntPeriods - avg * avg;
+        pstat->avgPeriodUs = avg;
+        pstat->jitterUs = (var > 0) ? sqrt(var) : 0;
+        pstat->rate = 1000000.0 / avg;
+    }
+    else {
+        pstat->avgPeriodUs = 0;
+        pstat->jitterUs = 0;
+        pstat->rate = 0;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// snapshot
+//
+
+void
+CIdStatistics::snapshot(std::vector<idStatistics> &stats, bool bReset)
+{
+    idStatistics stat;
+
+    stats.clear();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    stats.reserve(m_cntExtended + 64);
+
+    for (uint32_t id = 0; id < m_standard.size(); id++) {
+        if (0 == m_standard[id].count) {
+            continue;
+        }
+        stat.id = id;
+        stat.bExtended = false;
+        toStatistics(&m_standard[id], &stat);
+        stats.push_back(stat);
+    }
+
+    for (const entry &e : m_extended) {
+        if (0 == e.key) {
+            continue;
+        }
+        stat.id = e.key - 1;
+        stat.bExtended = true;
+        toStatistics(&e, &stat);
+        stats.push_back(stat);
+    }
+
+    if (bReset) {
+        clear();
+    }
+}
@@ -0,0 +1,143 @@
+///////////////////////////////////////////////////////////////////////////
+// idstats.h
+//
+// Per id traffic statistics kept by the receive threads.
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#if !defined(IDSTATS_H)
+#define IDSTATS_H
+
+#include <stdint.h>
+
+#include <mutex>
+#include <vector>
+
+#include "canal.h"
+
+// Initial size of the extended id table, power of two
+#define IDSTATS_HASH_INITIAL    256
+
+// Max number of extended ids tracked
+#define IDSTATS_HASH_MAX        65536
+
+/*!
+    Statistics for one id. Periods are in microseconds and taken
+    from the frame timestamps.
+*/
+typedef struct structIdStatistics {
+    uint32_t id;
+    bool bExtended;
+    uint64_t count;                     // Frames received
+    double rate;                        // Frames per second
+    uint32_t minPeriodUs;               // Shortest time between frames
+    double avgPeriodUs;                 // Average time between frames
+    uint32_t maxPeriodUs;               // Longest time between frames
+    double jitterUs;                    // Standard deviation of period
+} idStatistics;
+
+/*!
+    Count, period and jitter per id. Standard ids are kept in a
+    dense table, extended ids in an open addressing hash table.
+    Updated from the receive threads, read from any thread.
+*/
+class CIdStatistics {
+
+public:
+
+    CIdStatistics();
+    ~CIdStatistics();
+
+    /*!
+        Account a received frame
+
+        @param pmsg Received frame
+    */
+    void add(const canalMsg *pmsg);
+
+    /*!
+        Get statistics for all ids seen
+
+        @param stats Receives one item per id, standard ids first
+        @param bReset True to forget all ids after the snapshot
+    */
+    void snapshot(std::vector<idStatistics> &stats, bool bReset = false);
+
+    /*!
+        Forget all ids
+    */
+    void reset(void);
+
+    /*!
+        Number of extended ids not tracked because the table was full
+
+        @return Frames not accounted
+    */
+    uint64_t getOverflow(void) { return m_cntOverflow; };
+
+private:
+
+    // Aggregates for an id
+    typedef struct {
+        uint32_t key;                   // Extended id + 1, 0 = unused
+        uint32_t lastTimestamp;
+        uint64_t count;
+        uint32_t minPeriod;
+        uint32_t maxPeriod;
+        double sumPeriod;
+        double sumSqPeriod;
+    } entry;
+
+    // Account a frame in an entry
+    static void update(entry *pentry, uint32_t timestamp);
+
+    // Fill in statistics from an entry
+    static void toStatistics(const entry *pentry, idStatistics *pstat);
+
+    // Find or add an extended id, NULL if the table is full
+    entry *lookup(uint32_t id);
+
+    // Forget all ids. Lock must be held.
+    void clear(void);
+
+    // Double the hash table
+    void grow(void);
+
+    // Protects everything below
+    std::mutex m_mutex;
+
+    // Standard ids, indexed by id
+    std::vector<entry> m_standard;
+
+    // Extended ids
+    std::vector<entry> m_extended;
+    uint32_t m_cntExtended;
+
+    uint64_t m_cntOverflow;
+};
+
+#endif
@@ -0,0 +1,423 @@
+///////////////////////////////////////////////////////////////////////////
+// j1939.cpp
+//
+// SAE J1939 identifier decoding and transport protocol (BAM/CMDT)
+// reassembly.
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <string.h>
+
+#include <chrono>
+
+#include "j1939.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// constructor
+//
+
+CJ1939::CJ1939()
+{
+    m_bEnable      = false;
+    m_cntCompleted = 0;
+    m_cntAborted   = 0;
+    m_cntTimedOut  = 0;
+    m_cntFiltered  = 0;
+    m_lastExpire   = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// deconstructor
+//
+
+CJ1939::~CJ1939()
+{
+    reset();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// now
+//
+
+uint64_t
+CJ1939::now(void)
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// decodeId
+//
+
+void
+CJ1939::decodeId(uint32_t id,
+                    uint8_t *ppriority,
+                    uint32_t *ppgn,
+                    uint8_t *psrc,
+                    uint8_t *pdst)
+{
+    uint8_t pf = (id >> 16) & 0xff;
+    uint8_t ps = (id >> 8) & 0xff;
+
+    *ppriority = (id >> 26) & 0x07;
+    *psrc      = id & 0xff;
+
+    // EDP, DP and PF always belong to the PGN
+    *ppgn = (id >> 8) & 0x3ff00;
+
+    if (pf < 240) {
+        // PDU1 - PS is destination address
+        *pdst = ps;
+    }
+    else {
+        // PDU2 - PS is group extension
+        *ppgn |= ps;
+        *pdst = J1939_ADDR_GLOBAL;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// encodeId
+//
+
+uint32_t
+CJ1939::encodeId(uint8_t priority,
+                    uint32_t pgn,
+                    uint8_t src,
+                    uint8_t dst)
+{
+    uint32_t id = ((uint32_t)(priority & 0x07) << 26) | 
+                    ((pgn & 0x3ff00) << 8) | 
+                    src;
+
+    if (((pgn >> 8) & 0xff) < 240) {
+        // PDU1 - PS is destination address
+        id |= (uint32_t)dst << 8;
+    }
+    else {
+        // PDU2 - PS is group extension
+        id |= (pgn & 0xff) << 8;
+    }
+
+    return id;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// enable
+//
+
+void
+CJ1939::enable(bool bEnable)
+{
+    m_bEnable = bEnable;
+    if (!bEnable) {
+        reset();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// setPgnFilter
+//
+
+void
+CJ1939::setPgnFilter(const std::vector<uint32_t> &pgns)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_pgnFilter.clear();
+    for (uint32_t pgn : pgns) {
+        m_pgnFilter.insert(pgn & 0x3ffff);
+    }
+
+    // Drop transfers we no longer want
+    for (auto it = m_sessions.begin(); it != m_sessions.end();) {
+        if (!isPgnWanted(it->second.pgn)) {
+            it = m_sessions.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// isPgnWanted
+//
+
+bool
+CJ1939::isPgnWanted(uint32_t pgn)
+{
+    if (m_pgnFilter.empty()) {
+        return true;
+    }
+
+    return (m_pgnFilter.end() != m_pgnFilter.find(pgn));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// process
+//
+
+int
+CJ1939::process(const canalMsg *pmsg, j1939Msg *pout)
+{
+    uint8_t priority;
+    uint32_t pgn;
+    uint8_t src;
+    uint8_t dst;
+
+    if ((NULL == pmsg) || (NULL == pout) || !m_bEnable) {
+        return J1939_RESULT_IGNORED;
+    }
+
+    // Only extended data frames carry J1939
+    if (!(pmsg->flags & CANAL_IDFLAG_EXTENDED) ||
+        (pmsg->flags & (CANAL_IDFLAG_RTR | CANAL_IDFLAG_STATUS))) {
+        return J1939_RESULT_IGNORED;
+    }
+
+    decodeId(pmsg->id, &priority, &pgn, &src, &dst);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (J1939_PGN_TP_CM == pgn) {
+        processConnMgmt(pmsg, src, dst);
+        return J1939_RESULT_CONSUMED;
+    }
+
+    if (J1939_PGN_TP_DT == pgn) {
+        return processData(pmsg, src, dst, pout);
+    }
+
+    // Single frame message
+    if (!isPgnWanted(pgn)) {
+        m_cntFiltered++;
+        return J1939_RESULT_CONSUMED;
+    }
+
+    pout->pgn       = pgn;
+    pout->priority  = priority;
+    pout->src       = src;
+    pout->dst       = dst;
+    pout->id        = pmsg->id;
+    pout->flags     = pmsg->flags;
+    pout->obid      = pmsg->obid;
+    pout->timestamp = pmsg->timestamp;
+    pout->data.assign(pmsg->data,
+                      pmsg->data + ((pmsg->sizeData > 8) ? 8 : pmsg->sizeData));
+
+    return J1939_RESULT_MESSAGE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// processConnMgmt
+//
+
+void
+CJ1939::processConnMgmt(const canalMsg *pmsg, uint8_t src, uint8_t dst)
+{
+    if (pmsg->sizeData < 8) {
+        return;
+    }
+
+    uint64_t t    = now();
+    uint8_t ctrl  = pmsg->data[0];
+    uint32_t pgn  = pmsg->data[5] + (pmsg->data[6] << 8) + ((pmsg->data[7] & 0x03) << 16);
+    uint16_t key  = (src << 8) | dst;
+
+    expireLocked(t);
+
+    switch (ctrl) {
+
+        case J1939_TP_CM_BAM:
+        case J1939_TP_CM_RTS: {
+
+            uint16_t size   = pmsg->data[1] + (pmsg->data[2] << 8);
+            uint8_t packets = pmsg->data[3];
+
+            // A new announcement replaces any transfer in progress
+            m_sessions.erase(key);
+
+            if (!isPgnWanted(pgn)) {
+                m_cntFiltered++;
+                return;
+            }
+
+            if ((size < 9) || (size > J1939_TP_MAX_SIZE) ||
+                (packets != ((size + 6) / 7))) {
+                return;
+            }
+
+            j1939Session &session = m_sessions[key];
+            session.pgn           = pgn;
+            session.priority      = (pmsg->id >> 26) & 0x07;
+            session.bBam          = (J1939_TP_CM_BAM == ctrl);
+            session.size          = size;
+            session.packets       = packets;
+            session.received      = 0;
+            session.lastActivity  = t;
+            memset(session.seqmap, 0, sizeof(session.seqmap));
+            session.data.assign(packets * 7, 0xff);
+        } break;
+
+        case J1939_TP_CM_CTS: {
+            // Sent by the receiver. Keeps the session alive.
+            auto it = m_sessions.find((dst << 8) | src);
+            if (m_sessions.end() != it) {
+                it->second.lastActivity = t;
+            }
+        } break;
+
+        case J1939_TP_CM_ABORT: {
+            // Can be sent by either side
+            if (m_sessions.erase(key) + m_sessions.erase((dst << 8) | src)) {
+                m_cntAborted++;
+            }
+        } break;
+
+        default:
+            // EOM ack and reserved control bytes
+            break;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// processData
+//
+
+int
+CJ1939::processData(const canalMsg *pmsg,
+                        uint8_t src,
+                        uint8_t dst,
+                        j1939Msg *pout)
+{
+    if (pmsg->sizeData < 2) {
+        return J1939_RESULT_CONSUMED;
+    }
+
+    auto it = m_sessions.find((src << 8) | dst);
+    if (m_sessions.end() == it) {
+        return J1939_RESULT_CONSUMED;
+    }
+
+    // A late packet must not revive a transfer that has timed out
+    j1939Session &session = it->second;
+    uint64_t t            = now();
+    uint64_t timeout      = session.bBam ? J1939_TIMEOUT_BAM : J1939_TIMEOUT_CMDT;
+    if ((t - session.lastActivity) > timeout) {
+        m_sessions.erase(it);
+        m_cntTimedOut++;
+        return J1939_RESULT_CONSUMED;
+    }
+
+    uint8_t seq = pmsg->data[0];
+    if ((0 == seq) || (seq > session.packets)) {
+        return J1939_RESULT_CONSUMED;
+    }
+
+    session.lastActivity = t;
+
+    // Retransmitted packets (CMDT) are just overwritten
+    uint8_t len = ((pmsg->sizeData > 8) ? 8 : pmsg->sizeData) - 1;
+    memcpy(session.data.data() + (seq - 1) * 7, pmsg->data + 1, len);
+    if (!(session.seqmap[seq >> 3] & (1 << (seq & 7)))) {
+        session.seqmap[seq >> 3] |= (1 << (seq & 7));
+        session.received++;
+    }
+
+    if (session.received < session.packets) {
+        return J1939_RESULT_CONSUMED;
+    }
+
+    // Transfer is complete. The id is that of the transferred
+    // PGN, not of the last TP.DT frame.
+    pout->pgn       = session.pgn;
+    pout->priority  = session.priority;
+    pout->src       = src;
+    pout->dst       = dst;
+    pout->id        = encodeId(session.priority, session.pgn, src, dst);
+    pout->flags     = pmsg->flags;
+    pout->obid      = pmsg->obid;
+    pout->timestamp = pmsg->timestamp;
+    session.data.resize(session.size);
+    pout->data.swap(session.data);
+
+    m_sessions.erase(it);
+    m_cntCompleted++;
+
+    return J1939_RESULT_MESSAGE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// expire
+//
+
+void
+CJ1939::expire(void)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    expireLocked(now());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// expireLocked
+//
+
+void
+CJ1939::expireLocked(uint64_t t)
+{
+    // No need to scan more often than this
+    if ((t - m_lastExpire) < 100) {
+        return;
+    }
+    m_lastExpire = t;
+
+    for (auto it = m_sessions.begin(); it != m_sessions.end();) {
+        uint64_t timeout =
+          it->second.bBam ? J1939_TIMEOUT_BAM : J1939_TIMEOUT_CMDT;
+        if ((t - it->second.lastActivity) > timeout) {
+            it = m_sessions.erase(it);
+            m_cntTimedOut++;
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// reset
+//
+
+void
+CJ1939::reset(void)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_sessions.clear();
+}
@@ -0,0 +1,223 @@
+///////////////////////////////////////////////////////////////////////////
+// j1939.h
+//
+// SAE J1939 identifier decoding and transport protocol (BAM/CMDT)
+// reassembly.
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#if !defined(J1939_H)
+#define J1939_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "canal.h"
+
+// Transport protocol PGN's
+#define J1939_PGN_TP_CM             0x00EC00    // Connection management
+#define J1939_PGN_TP_DT             0x00EB00    // Data transfer
+
+// TP.CM control bytes
+#define J1939_TP_CM_RTS             16          // Request to send
+#define J1939_TP_CM_CTS             17          // Clear to send
+#define J1939_TP_CM_EOMACK          19          // End of message ack
+#define J1939_TP_CM_BAM             32          // Broadcast announce
+#define J1939_TP_CM_ABORT           255         // Connection abort
+
+// Max payload of a multi-packet transfer (255 packets * 7 bytes)
+#define J1939_TP_MAX_SIZE           1785
+
+// Global (broadcast) destination address
+#define J1939_ADDR_GLOBAL           0xFF
+
+// Session timeouts in milliseconds (T1 for BAM, T2/T3 for CMDT)
+#define J1939_TIMEOUT_BAM           750
+#define J1939_TIMEOUT_CMDT          1250
+
+// Result codes from CJ1939::process
+#define J1939_RESULT_IGNORED        0           // Not a J1939 frame
+#define J1939_RESULT_CONSUMED       1           // Swallowed (TP or filtered)
+#define J1939_RESULT_MESSAGE        2           // Complete message delivered
+
+/*!
+    A complete J1939 message. Either a single frame or a
+    reassembled multi-packet transfer.
+*/
+typedef struct structJ1939Msg {
+    uint32_t pgn;                       // Parameter group number
+    uint8_t priority;                   // Priority 0-7
+    uint8_t src;                        // Source address
+    uint8_t dst;                        // Destination address (0xFF global)
+    unsigned long id;                   // CAN id of the (last) frame
+    unsigned long flags;                // CANAL flags of the (last) frame
+    unsigned long obid;                 // obid of the (last) frame
+    unsigned long timestamp;            // Timestamp of the (last) frame
+    std::vector<uint8_t> data;          // Payload 0-1785 bytes
+} j1939Msg;
+
+class CJ1939 {
+
+public:
+
+    CJ1939();
+    ~CJ1939();
+
+    /*!
+        Decode a 29-bit J1939 identifier
+
+        @param id CAN id
+        @param ppriority Receives priority
+        @param ppgn Receives PGN (destination removed for PDU1 format)
+        @param psrc Receives source address
+        @param pdst Receives destination address (0xFF for PDU2 format)
+    */
+    static void decodeId(uint32_t id,
+                            uint8_t *ppriority,
+                            uint32_t *ppgn,
+                            uint8_t *psrc,
+                            uint8_t *pdst);
+
+    /*!
+        Encode a 29-bit J1939 identifier
+
+        @param priority Priority (0-7)
+        @param pgn PGN
+        @param src Source address
+        @param dst Destination address, only used for PDU1 format
+        @return CAN id
+    */
+    static uint32_t encodeId(uint8_t priority,
+                                uint32_t pgn,
+                                uint8_t src,
+                                uint8_t dst);
+
+    /*!
+        Enable/disable J1939 processing
+
+        @param bEnable True to enable processing
+    */
+    void enable(bool bEnable);
+
+    /*!
+        Check if J1939 processing is enabled
+
+        @return True if enabled
+    */
+    bool isEnabled(void) { return m_bEnable; };
+
+    /*!
+        Set PGN filter. Only PGN's in the set is delivered and only
+        transfers for them is reassembled.
+
+        @param pgns PGN's to accept. Empty accepts all.
+    */
+    void setPgnFilter(const std::vector<uint32_t> &pgns);
+
+    /*!
+        Process a received frame
+
+        @param pmsg Pointer to received CAN message
+        @param pout Filled in with a complete message when
+                    J1939_RESULT_MESSAGE is returned
+        @return J1939_RESULT_IGNORED, J1939_RESULT_CONSUMED or
+                    J1939_RESULT_MESSAGE
+    */
+    int process(const canalMsg *pmsg, j1939Msg *pout);
+
+    /*!
+        Drop sessions that have timed out. Called by the receive
+        loop also when no frames arrive.
+    */
+    void expire(void);
+
+    /*!
+        Drop all active sessions
+    */
+    void reset(void);
+
+    // Statistics
+    std::atomic<uint32_t> m_cntCompleted;   // Reassembled transfers
+    std::atomic<uint32_t> m_cntAborted;     // Aborted by a node
+    std::atomic<uint32_t> m_cntTimedOut;    // Dropped due to timeout
+    std::atomic<uint32_t> m_cntFiltered;    // Dropped by PGN filter
+
+private:
+
+    // An in progress transfer
+    typedef struct {
+        uint32_t pgn;
+        uint8_t priority;
+        bool bBam;
+        uint16_t size;
+        uint8_t packets;
+        uint8_t received;
+        uint8_t seqmap[32];             // One bit per received sequence no
+        uint64_t lastActivity;          // ms
+        std::vector<uint8_t> data;
+    } j1939Session;
+
+    // Get ms on monotonic clock
+    static uint64_t now(void);
+
+    // True if PGN is accepted by filter (m_mutex held)
+    bool isPgnWanted(uint32_t pgn);
+
+    // Handle TP.CM frame (m_mutex held)
+    void processConnMgmt(const canalMsg *pmsg, uint8_t src, uint8_t dst);
+
+    // Handle TP.DT frame (m_mutex held)
+    int processData(const canalMsg *pmsg,
+                        uint8_t src,
+                        uint8_t dst,
+                        j1939Msg *pout);
+
+    // Expire sessions (m_mutex held)
+    void expireLocked(uint64_t t);
+
+    // True if processing is enabled
+    std::atomic<bool> m_bEnable;
+
+    // Protects sessions and filter
+    std::mutex m_mutex;
+
+    // Accepted PGN's (empty is all)
+    std::unordered_set<uint32_t> m_pgnFilter;
+
+    // Active sessions keyed by (src << 8) | dst
+    std::unordered_map<uint16_t, j1939Session> m_sessions;
+
+    // Time for last expire run
+    uint64_t m_lastExpire;
+};
+
+#endif
@@ -0,0 +1,358 @@
+///////////////////////////////////////////////////////////////////////////
+// jsonvalue.cpp
+//
+// Minimal JSON reader used for structured init.
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <stdlib.h>
+
+#include "jsonvalue.h"
+
+// Deepest nesting accepted
+#define JSON_MAX_DEPTH      32
+
+///////////////////////////////////////////////////////////////////////////////
+// skipSpace
+//
+
+static void
+skipSpace(const std::string &str, size_t &pos)
+{
+    while ((pos < str.size()) &&
+           ((' ' == str[pos]) || ('\t' == str[pos]) ||
+            ('\n' == str[pos]) || ('\r' == str[pos]))) {
+        pos++;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// appendUtf8
+//
+
+static void
+appendUtf8(std::string &out, unsigned long cp)
+{
+    if (cp < 0x80) {
+        out += (char)cp;
+    }
+    else if (cp < 0x800) {
+        out += (char)(0xc0 | (cp >> 6));
+        out += (char)(0x80 | (cp & 0x3f));
+    }
+    else if (cp < 0x10000) {
+        out += (char)(0xe0 | (cp >> 12));
+        out += (char)(0x80 | ((cp >> 6) & 0x3f));
+        out += (char)(0x80 | (cp & 0x3f));
+    }
+    else {
+        out += (char)(0xf0 | (cp >> 18));
+        out += (char)(0x80 | ((cp >> 12) & 0x3f));
+        out += (char)(0x80 | ((cp >> 6) & 0x3f));
+        out += (char)(0x80 | (cp & 0x3f));
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// constructor
+//
+
+CJsonValue::CJsonValue()
+{
+    m_type   = JSON_NULL;
+    m_bool   = false;
+    m_number = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// deconstructor
+//
+
+CJsonValue::~CJsonValue()
+{
+    ;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// parse
+//
+
+bool
+CJsonValue::parse(const std::string &str, std::string &strError)
+{
+    size_t pos = 0;
+
+    *this = CJsonValue();
+    if (!parseValue(str, pos, 0, strError)) {
+        return false;
+    }
+
+    skipSpace(str, pos);
+    if (pos != str.size()) {
+        strError = "Unexpected data after JSON value at " + std::to_string(pos);
+        return false;
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// has
+//
+
+bool
+CJsonValue::has(const std::string &key) const
+{
+    return (m_object.end() != m_object.find(key));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// get
+//
+
+const CJsonValue &
+CJsonValue::get(const std::string &key) const
+{
+    static const CJsonValue null;
+
+    auto it = m_object.find(key);
+    if (m_object.end() == it) {
+        return null;
+    }
+
+    return it->second;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// parseString
+//
+
+bool
+CJsonValue::parseString(const std::string &str,
+                            size_t &pos,
+                            std::string &out,
+                            std::string &strError)
+{
+    // Opening quote already checked
+    pos++;
+
+    while (pos < str.size()) {
+
+        char c = str[pos++];
+
+        if ('"' == c) {
+            return true;
+        }
+
+        if ('\\' != c) {
+            out += c;
+            continue;
+        }
+
+        if (pos >= str.size()) {
+            break;
+        }
+
+        c = str[pos++];
+        switch (c) {
+            case '"':  out += '"'; break;
+            case '\\': out += '\\'; break;
+            case '/':  out += '/'; break;
+            case 'b':  out += '\b'; break;
+            case 'f':  out += '\f'; break;
+            case 'n':  out += '\n'; break;
+            case 'r':  out += '\r'; break;
+            case 't':  out += '\t'; break;
+            case 'u': {
+                if ((pos + 4) > str.size()) {
+                    strError = "Bad unicode escape at " + std::to_string(pos);
+                    return false;
+                }
+                unsigned long cp = strtoul(str.substr(pos, 4).c_str(), NULL, 16);
+                pos += 4;
+
+                // Surrogate pair
+                if ((cp >= 0xd800) && (cp <= 0xdbff) &&
+                    ((pos + 6) <= str.size()) &&
+                    ('\\' == str[pos]) && ('u' == str[pos + 1])) {
+                    unsigned long lo = strtoul(str.substr(pos + 2, 4).c_str(), NULL, 16);
+                    if ((lo >= 0xdc00) && (lo <= 0xdfff)) {
+                        cp = 0x10000 + ((cp - 0xd800) << 10) + (lo - 0xdc00);
+                        pos += 6;
+                    }
+                }
+                appendUtf8(out, cp);
+                break;
+            }
+            default:
+                strError = "Bad escape at " + std::to_string(pos - 1);
+                return false;
+        }
+    }
+
+    strError = "Unterminated string";
+    return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// parseValue
+//
+
+bool
+CJsonValue::parseValue(const std::string &str,
+                            size_t &pos,
+                            int depth,
+                            std::string &strError)
+{
+    if (depth > JSON_MAX_DEPTH) {
+        strError = "JSON nested too deep";
+        return false;
+    }
+
+    skipSpace(str, pos);
+    if (pos >= str.size()) {
+        strError = "Unexpected end of JSON";
+        return false;
+    }
+
+    char c = str[pos];
+
+    // Object
+    if ('{' == c) {
+        m_type = JSON_OBJECT;
+        pos++;
+        skipSpace(str, pos);
+        if ((pos < str.size()) && ('}' == str[pos])) {
+            pos++;
+            return true;
+        }
+        for (;;) {
+            skipSpace(str, pos);
+            if ((pos >= str.size()) || ('"' != str[pos])) {
+                strError = "Expected member name at " + std::to_string(pos);
+                return false;
+            }
+            std::string key;
+            if (!parseString(str, pos, key, strError)) {
+                return false;
+            }
+            skipSpace(str, pos);
+            if ((pos >= str.size()) || (':' != str[pos])) {
+                strError = "Expected ':' at " + std::to_string(pos);
+                return false;
+            }
+            pos++;
+            CJsonValue &member = m_object[key];
+            if (!member.parseValue(str, pos, depth + 1, strError)) {
+                return false;
+            }
+            skipSpace(str, pos);
+            if ((pos < str.size()) && (',' == str[pos])) {
+                pos++;
+                continue;
+            }
+            if ((pos < str.size()) && ('}' == str[pos])) {
+                pos++;
+                return true;
+            }
+            strError = "Expected ',' or '}' at " + std::to_string(pos);
+            return false;
+        }
+    }
+
+    // Array
+    if ('[' == c) {
+        m_type = JSON_ARRAY;
+        pos++;
+        skipSpace(str, pos);
+        if ((pos < str.size()) && (']' == str[pos])) {
+            pos++;
+            return true;
+        }
+        for (;;) {
+            m_array.emplace_back();
+            if (!m_array.back().parseValue(str, pos, depth + 1, strError)) {
+                return false;
+            }
+            skipSpace(str, pos);
+            if ((pos < str.size()) && (',' == str[pos])) {
+                pos++;
+                continue;
+            }
+            if ((pos < str.size()) && (']' == str[pos])) {
+                pos++;
+                return true;
+            }
+            strError = "Expected ',' or ']' at " + std::to_string(pos);
+            return false;
+        }
+    }
+
+    // String
+    if ('"' == c) {
+        m_type = JSON_STRING;
+        return parseString(str, pos, m_string, strError);
+    }
+
+    // Literals
+    if (0 == str.compare(pos, 4, "true")) {
+        m_type = JSON_BOOL;
+        m_bool = true;
+        pos += 4;
+        return true;
+    }
+
+    if (0 == str.compare(pos, 5, "false")) {
+        m_type = JSON_BOOL;
+        m_bool = false;
+        pos += 5;
+        return true;
+    }
+
+    if (0 == str.compare(pos, 4, "null")) {
+        m_type = JSON_NULL;
+        pos += 4;
+        return true;
+    }
+
+    // Number
+    if (('-' == c) || ((c >= '0') && (c <= '9'))) {
+        const char *start = str.c_str() + pos;
+        char *end;
+        m_number = strtod(start, &end);
+        if (end == start) {
+            strError = "Bad number at " + std::to_string(pos);
+            return false;
+        }
+        m_type = JSON_NUMBER;
+        pos += (end - start);
+        return true;
+    }
+
+    strError = "Unexpected character at " + std::to_string(pos);
+    return false;
+}
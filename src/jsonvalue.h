@@ -0,0 +1,120 @@
+///////////////////////////////////////////////////////////////////////////
+// jsonvalue.h
+//
+// Minimal JSON reader used for structured init.
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#if !defined(JSONVALUE_H)
+#define JSONVALUE_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+/*!
+    A parsed JSON value. Only what is needed to read configuration,
+    there is no serializer.
+*/
+class CJsonValue {
+
+public:
+
+    enum jsonType {
+        JSON_NULL,
+        JSON_BOOL,
+        JSON_NUMBER,
+        JSON_STRING,
+        JSON_ARRAY,
+        JSON_OBJECT
+    };
+
+    CJsonValue();
+    ~CJsonValue();
+
+    /*!
+        Parse a JSON document
+
+        @param str JSON text
+        @param strError Receives a description of the error
+        @return True on success
+    */
+    bool parse(const std::string &str, std::string &strError);
+
+    jsonType getType(void) const { return m_type; };
+    bool isNull(void) const { return (JSON_NULL == m_type); };
+    bool isBool(void) const { return (JSON_BOOL == m_type); };
+    bool isNumber(void) const { return (JSON_NUMBER == m_type); };
+    bool isString(void) const { return (JSON_STRING == m_type); };
+    bool isArray(void) const { return (JSON_ARRAY == m_type); };
+    bool isObject(void) const { return (JSON_OBJECT == m_type); };
+
+    bool getBool(void) const { return m_bool; };
+    double getNumber(void) const { return m_number; };
+    const std::string &getString(void) const { return m_string; };
+
+    /*!
+        Array size, zero for non arrays
+    */
+    size_t size(void) const { return m_array.size(); };
+
+    /*!
+        Array item
+    */
+    const CJsonValue &at(size_t idx) const { return m_array.at(idx); };
+
+    /*!
+        Check if an object has a member
+
+        @param key Name of member
+        @return True if it has
+    */
+    bool has(const std::string &key) const;
+
+    /*!
+        Get an object member
+
+        @param key Name of member
+        @return The member or a null value if there is no such member
+    */
+    const CJsonValue &get(const std::string &key) const;
+
+private:
+
+    // Recursive descent, pos is advanced past the value
+    bool parseValue(const std::string &str, size_t &pos, int depth, std::string &strError);
+    bool parseString(const std::string &str, size_t &pos, std::string &out, std::string &strError);
+
+    jsonType m_type;
+    bool m_bool;
+    double m_number;
+    std::string m_string;
+    std::vector<CJsonValue> m_array;
+    std::map<std::string, CJsonValue> m_object;
+};
+
+#endif
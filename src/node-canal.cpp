@@ -29,16 +29,18 @@
 // SOFTWARE.
 //
 
+#include <math.h>
+
+#include <algorithm>
 #include <chrono>
 #include <thread>
 
+#include "canalworkers.h"
 #include "node-canal.h"
 
 // Workerthreads
 void *deviceReceiveThread(void *pData);
 
-Napi::FunctionReference CNodeCanal::constructor;
-
 Napi::Object CNodeCanal::Init(Napi::Env env, Napi::Object exports) {
 
   Napi::HandleScope scope(env);
@@ -68,11 +70,77 @@ Napi::Object CNodeCanal::Init(Napi::Env env, Napi::Object exports) {
        InstanceMethod("getVersion", &CNodeCanal::getVersion),
        InstanceMethod("getDllVersion", &CNodeCanal::getDllVersion),
        InstanceMethod("getVendorString", &CNodeCanal::getVendorString),
-       InstanceMethod("getDriverInfo", &CNodeCanal::getDriverInfo)
+       InstanceMethod("getDriverInfo", &CNodeCanal::getDriverInfo),
+       InstanceMethod("enableJ1939", &CNodeCanal::enableJ1939),
+       InstanceMethod("disableJ1939", &CNodeCanal::disableJ1939),
+       InstanceMethod("getJ1939Statistics", &CNodeCanal::getJ1939Statistics),
+       InstanceMethod("enableVscp", &CNodeCanal::enableVscp),
+       InstanceMethod("disableVscp", &CNodeCanal::disableVscp),
+       InstanceMethod("addCyclic", &CNodeCanal::addCyclic),
+       InstanceMethod("updateCyclic", &CNodeCanal::updateCyclic),
+       InstanceMethod("removeCyclic", &CNodeCanal::removeCyclic),
+       InstanceMethod("getCyclicStatistics", &CNodeCanal::getCyclicStatistics),
+       InstanceMethod("sendAndWait", &CNodeCanal::sendAndWait),
+       InstanceMethod("openAsync", &CNodeCanal::openAsync),
+       InstanceMethod("closeAsync", &CNodeCanal::closeAsync),
+       InstanceMethod("getStatusAsync", &CNodeCanal::getStatusAsync),
+       InstanceMethod("getStatisticsAsync", &CNodeCanal::getStatisticsAsync),
+       InstanceMethod("setBaudrateAsync", &CNodeCanal::setBaudrateAsync),
+       InstanceMethod("receiveAsync", &CNodeCanal::receiveAsync),
+       InstanceMethod("startStream", &CNodeCanal::startStream),
+       InstanceMethod("readBatch", &CNodeCanal::readBatch),
+       InstanceMethod("stopStream", &CNodeCanal::stopStream),
+       InstanceMethod("enableBroadcast", &CNodeCanal::enableBroadcast),
+       InstanceMethod("disableBroadcast", &CNodeCanal::disableBroadcast),
+       InstanceMethod("attachBroadcast", &CNodeCanal::attachBroadcast),
+       InstanceMethod("addReader", &CNodeCanal::addReader),
+       InstanceMethod("removeReader", &CNodeCanal::removeReader),
+       InstanceMethod("getReaderStatistics", &CNodeCanal::getReaderStatistics),
+       InstanceMethod("setReceiveSpin", &CNodeCanal::setReceiveSpin),
+       InstanceMethod("getReceiveStatistics", &CNodeCanal::getReceiveStatistics),
+       InstanceMethod("setDeliveryPolicy", &CNodeCanal::setDeliveryPolicy),
+       InstanceMethod("getDeliveryStatistics", &CNodeCanal::getDeliveryStatistics),
+       InstanceMethod("loadDbc", &CNodeCanal::loadDbc),
+       InstanceMethod("unloadDbc", &CNodeCanal::unloadDbc),
+       InstanceMethod("setSignalFilter", &CNodeCanal::setSignalFilter),
+       InstanceMethod("getDbcMessages", &CNodeCanal::getDbcMessages),
+       InstanceMethod("decodeFrame", &CNodeCanal::decodeFrame),
+       InstanceMethod("encodeFrame", &CNodeCanal::encodeFrame),
+       InstanceMethod("sendSignals", &CNodeCanal::sendSignals),
+       InstanceMethod("setDeliveryFormat", &CNodeCanal::setDeliveryFormat),
+       InstanceMethod("readColumns", &CNodeCanal::readColumns),
+       InstanceMethod("enableIdStatistics", &CNodeCanal::enableIdStatistics),
+       InstanceMethod("disableIdStatistics", &CNodeCanal::disableIdStatistics),
+       InstanceMethod("getIdStatistics", &CNodeCanal::getIdStatistics),
+       InstanceMethod("enableBusLoad", &CNodeCanal::enableBusLoad),
+       InstanceMethod("disableBusLoad", &CNodeCanal::disableBusLoad),
+       InstanceMethod("getBusLoad", &CNodeCanal::getBusLoad),
+       InstanceMethod("watchStatus", &CNodeCanal::watchStatus),
+       InstanceMethod("unwatchStatus", &CNodeCanal::unwatchStatus),
+       InstanceMethod("watchRecovery", &CNodeCanal::watchRecovery),
+       InstanceMethod("unwatchRecovery", &CNodeCanal::unwatchRecovery),
+       InstanceMethod("setTxRate", &CNodeCanal::setTxRate),
+       InstanceMethod("getTxStatistics", &CNodeCanal::getTxStatistics),
+       InstanceMethod("sendBlocking", &CNodeCanal::sendBlocking),
+       InstanceMethod("sendRaw", &CNodeCanal::sendRaw),
+       InstanceMethod("receiveInto", &CNodeCanal::receiveInto),
+       InstanceMethod("receiveMany", &CNodeCanal::receiveMany)
        });
 
-  constructor = Napi::Persistent(func);
-  constructor.SuppressDestruct();
+  // Per environment so every worker thread gets its own. Deleted
+  // by the default finalizer when the environment is torn down.
+  addonData *pdata = new addonData;
+  pdata->constructor = Napi::Persistent(func);
+  pdata->keys.flags = Napi::Persistent(Napi::String::New(env, "flags"));
+  pdata->keys.ext = Napi::Persistent(Napi::String::New(env, "ext"));
+  pdata->keys.rtr = Napi::Persistent(Napi::String::New(env, "rtr"));
+  pdata->keys.timestamp = Napi::Persistent(Napi::String::New(env, "timestamp"));
+  pdata->keys.obid = Napi::Persistent(Napi::String::New(env, "obid"));
+  pdata->keys.id = Napi::Persistent(Napi::String::New(env, "id"));
+  pdata->keys.data = Napi::Persistent(Napi::String::New(env, "data"));
+  pdata->keys.sizeData = Napi::Persistent(Napi::String::New(env, "sizeData"));
+  pdata->keys.priority = Napi::Persistent(Napi::String::New(env, "priority"));
+  env.SetInstanceData<addonData>(pdata);
 
   exports.Set("CNodeCanal", func);
 
@@ -134,6 +202,15 @@ Napi::Object CNodeCanal::Init(Napi::Env env, Napi::Object exports) {
   exports.Set("CANAL_BAUD_20", Napi::Number::New(env,   8 ));  /*  20 Kbit */
   exports.Set("CANAL_BAUD_10", Napi::Number::New(env,   9 ));  /*  10 Kbit */
 
+  /* Frame record layout for receiveInto */
+  exports.Set("RECORD_SIZE", Napi::Number::New(env,             RECORD_SIZE ));
+  exports.Set("RECORD_OFFSET_ID", Napi::Number::New(env,        RECORD_OFFSET_ID ));
+  exports.Set("RECORD_OFFSET_FLAGS", Napi::Number::New(env,     RECORD_OFFSET_FLAGS ));
+  exports.Set("RECORD_OFFSET_OBID", Napi::Number::New(env,      RECORD_OFFSET_OBID ));
+  exports.Set("RECORD_OFFSET_TIMESTAMP", Napi::Number::New(env, RECORD_OFFSET_TIMESTAMP ));
+  exports.Set("RECORD_OFFSET_DATA", Napi::Number::New(env,      RECORD_OFFSET_DATA ));
+  exports.Set("RECORD_OFFSET_SIZE", Napi::Number::New(env,      RECORD_OFFSET_SIZE ));
+
   return exports;
 }
 
@@ -143,8 +220,135 @@ CNodeCanal::CNodeCanal(const Napi::CallbackInfo &info)
   Napi::Env env = info.Env();
   Napi::HandleScope scope(env);
 
+  m_bListening = false;
+  m_bListenerRunning = false;
+  m_bColumnar = false;
+  m_bBroadcastOwner = false;
+  m_bRecoveryWatch = false;
+  m_cyclic.setInterface(&m_canalif);
+
+  // Stop threads if the environment goes away (worker terminated,
+  // process exit) before close is called
+  napi_add_env_cleanup_hook(env, cleanupHook, this);
+}
+
+CNodeCanal::~CNodeCanal() {
+  napi_remove_env_cleanup_hook(Env(), cleanupHook, this);
+  shutdown();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// cleanupHook
+//
+
+void CNodeCanal::cleanupHook(void *arg) {
+  CNodeCanal *pobj = (CNodeCanal *)arg;
+  pobj->shutdown();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// shutdown
+//
+
+void CNodeCanal::shutdown(void) {
+
+  m_canalif.m_bQuit = true; // Quit the main loop
+  m_canalif.setRecoveryCallback(nullptr);
+  m_cyclic.stop();          // No more periodic sends
+  m_stream.quit();          // Stop frame stream reader
+  m_statusWatcher.stop();   // No more status polls
+  stopBroadcast();          // End broadcast and its readers
+
+  // The listener thread use this object until it has quit
+  while (m_bListenerRunning) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  if (m_canalif.m_openHandle || m_canalif.m_bRecoverThread) {
+    m_canalif.CanalClose();
+  }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// arrayToVector
+//
+// Collect the numbers in a JS array. Non arrays give an empty vector.
+//
+
+static void arrayToVector(Napi::Value value, std::vector<uint32_t> &vec) {
+
+  vec.clear();
+
+  if (!value.IsArray()) {
+    return;
+  }
+
+  Napi::Array arr = value.As<Napi::Array>();
+  for (uint32_t i = 0; i < arr.Length(); i++) {
+    Napi::Value val = arr[i];
+    if (val.IsNumber()) {
+      vec.push_back((uint32_t)val.As<Napi::Number>());
+    }
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// valueToPolicy
+//
+// Set listener delivery policy from a profile name or a
+// { maxFrames, maxHoldUs } object. Returns false if invalid.
+//
+
+static bool valueToPolicy(Napi::Value value, CCoalescer &coalesce) {
+
+  if (value.IsString()) {
+    std::string profile = value.As<Napi::String>().Utf8Value();
+    if ("lowLatency" == profile) {
+      coalesce.setPolicy(COALESCE_LOW_LATENCY_FRAMES, COALESCE_LOW_LATENCY_HOLD_US);
+      return true;
+    }
+    if ("highThroughput" == profile) {
+      coalesce.setPolicy(COALESCE_HIGH_THROUGHPUT_FRAMES, COALESCE_HIGH_THROUGHPUT_HOLD_US);
+      return true;
+    }
+    return false;
+  }
+
+  if (!value.IsObject()) {
+    return false;
+  }
+
+  Napi::Object obj = value.As<Napi::Object>();
+  uint32_t maxFrames = COALESCE_LOW_LATENCY_FRAMES;
+  uint32_t maxHoldUs = COALESCE_LOW_LATENCY_HOLD_US;
+  if (obj.Get("maxFrames").IsNumber()) {
+    maxFrames = (uint32_t)obj.Get("maxFrames").As<Napi::Number>();
+  }
+  if (obj.Get("maxHoldUs").IsNumber()) {
+    maxHoldUs = (uint32_t)obj.Get("maxHoldUs").As<Napi::Number>();
+  }
+  coalesce.setPolicy(maxFrames, maxHoldUs);
+
+  return true;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// valueToJson
+//
+// JSON text for a JS value. Empty if it can't be stringified.
+//
+
+static std::string valueToJson(Napi::Env env, Napi::Value value) {
+
+  Napi::Object json = env.Global().Get("JSON").As<Napi::Object>();
+  Napi::Value str = json.Get("stringify").As<Napi::Function>().Call(json, {value});
+  if (env.IsExceptionPending() || !str.IsString()) {
+    return std::string();
+  }
+
+  return str.As<Napi::String>().Utf8Value();
+}
 
 ///////////////////////////////////////////////////////////////////////////////
 // init
@@ -155,38 +359,122 @@ Napi::Value CNodeCanal::init(const Napi::CallbackInfo &info) {
   Napi::Env env = info.Env();
   Napi::HandleScope scope(env);
 
-  if (info.Length() < 3) {
-    Napi::TypeError::New(env, "Three or four arguments expected (path, param, flags[,function])")
-        .ThrowAsJavaScriptException();
+  canalConfig cfg;
+  CCanalIf::initConfig(&cfg);
+
+  bool bCallback = false;
+  bool bPositional = false;
+  std::string json;
+
+  // init(options|json[, callback])
+  if ((info.Length() >= 1) && (info.Length() <= 2) &&
+      (info[0].IsObject() || info[0].IsString())) {
+
+    if ((2 == info.Length()) && !info[1].IsFunction()) {
+      Napi::TypeError::New(env, "Second argument should be a function")
+          .ThrowAsJavaScriptException();
+      return Napi::Number::New(env, CANAL_ERROR_PARAMETER);
+    }
+
+    bCallback = (2 == info.Length());
+    if (bCallback) {
+      m_callback = info[1].As<Napi::Function>();
+    }
+
+    if (info[0].IsString()) {
+      json = info[0].As<Napi::String>().Utf8Value();
+    }
+    else {
+      json = valueToJson(env, info[0]);
+      if (json.empty()) {
+        return Napi::Number::New(env, CANAL_ERROR_PARAMETER);
+      }
+    }
   }
+  // init(path, param, flags[,callback][,options])
+  else {
 
-  if ((3 == info.Length()) && 
-      (!info[0].IsString() || !info[1].IsString() || !info[2].IsNumber())) {
-    Napi::TypeError::New(env, "Three or four arguments expected (path, param, flags[,function])")
-        .ThrowAsJavaScriptException();
+    if ((info.Length() < 3) || (info.Length() > 5)) {
+      Napi::TypeError::New(env, "One or two arguments (options[,function]) or three to five arguments (path, param, flags[,function][,options]) expected")
+          .ThrowAsJavaScriptException();
+      return Napi::Number::New(env, CANAL_ERROR_PARAMETER);
+    }
+
+    if (!info[0].IsString() || !info[1].IsString() || !info[2].IsNumber()) {
+      Napi::TypeError::New(env, "Three to five arguments expected (path, param, flags[,function][,options])")
+          .ThrowAsJavaScriptException();
+      return Napi::Number::New(env, CANAL_ERROR_PARAMETER);
+    }
+
+    // Optional callback followed by optional options
+    bCallback = (info.Length() >= 4) && info[3].IsFunction();
+    uint32_t idxOptions = bCallback ? 4 : 3;
+
+    if ((4 == info.Length()) && !info[3].IsFunction() && !info[3].IsObject()) {
+      Napi::TypeError::New(env, "Fourth argument should be a function or an options object")
+          .ThrowAsJavaScriptException();
+      return Napi::Number::New(env, CANAL_ERROR_PARAMETER);
+    }
+
+    if ((5 == info.Length()) && (!bCallback || !info[4].IsObject())) {
+      Napi::TypeError::New(env, "Five arguments expected (path, param, flags, function, options)")
+          .ThrowAsJavaScriptException();
+      return Napi::Number::New(env, CANAL_ERROR_PARAMETER);
+    }
+
+    if (bCallback) {
+      m_callback = info[3].As<Napi::Function>();
+    }
+
+    if (info.Length() > idxOptions) {
+      json = valueToJson(env, info[idxOptions]);
+      if (json.empty()) {
+        return Napi::Number::New(env, CANAL_ERROR_PARAMETER);
+      }
+    }
+
+    bPositional = true;
+  }
+
+  if (!json.empty()) {
+    std::string strError;
+    int rv = CCanalIf::parseConfig(json, &cfg, strError);
+    if (CANAL_ERROR_SUCCESS != rv) {
+      Napi::TypeError::New(env, strError).ThrowAsJavaScriptException();
+      return Napi::Number::New(env, rv);
+    }
   }
 
-  if ((4 == info.Length()) && !info[3].IsFunction()) {
-    Napi::TypeError::New(env, "Four arguments expected (path, param, flags, function)")
-        .ThrowAsJavaScriptException();      
+  if (bPositional) {
+    cfg.path = info[0].As<Napi::String>().Utf8Value();
+    cfg.config = info[1].As<Napi::String>().Utf8Value();
+    cfg.flags = (uint32_t)info[2].As<Napi::Number>();
   }
 
-  Napi::String path = info[0].As<Napi::String>();
-  Napi::String param = info[1].As<Napi::String>();
-  Napi::Number flags = info[2].As<Napi::Number>();
+  // J1939 and VSCP messages can't be delivered as columns
+  if (cfg.bColumnar && (m_j1939.isEnabled() || m_vscp.isEnabled())) {
+    Napi::Error err = Napi::Error::New(env, "The columnar delivery format is not supported with J1939 or VSCP decoding enabled");
+    err.Value().Set("code", CANAL_ERROR_NOT_SUPPORTED);
+    err.ThrowAsJavaScriptException();
+    return Napi::Number::New(env, CANAL_ERROR_NOT_SUPPORTED);
+  }
 
-  if (4 == info.Length()) {
-    m_callback = info[3].As<Napi::Function>();
-  } 
-  
-  int rv = this->m_canalif.init(path.ToString(), 
-                                  param.ToString(),
-                                  (uint32_t)flags.ToNumber());
+  // Errors in the init data are thrown, driver load errors
+  // are returned
+  int rv = m_canalif.init(&cfg);
+  if ((CANAL_ERROR_SUCCESS != rv) && !m_canalif.m_strError.empty()) {
+    Napi::Error err = Napi::Error::New(env, m_canalif.m_strError);
+    err.Value().Set("code", rv);
+    err.ThrowAsJavaScriptException();
+    return Napi::Number::New(env, rv);
+  }
+
+  m_coalesce.setPolicy(cfg.deliveryMaxFrames, cfg.deliveryMaxHoldUs);
+  m_bColumnar = cfg.bColumnar;
 
   // Start listener if init succeeded and we have a callback 
   // function. Poll otherwise
-  if ( (CANAL_ERROR_SUCCESS == rv) && 
-      (4 == info.Length()) ) {
+  if ( (CANAL_ERROR_SUCCESS == rv) && bCallback ) {
      addListener(env, m_callback);
   }
 
@@ -231,11 +519,113 @@ Napi::Value CNodeCanal::close(const Napi::CallbackInfo &info) {
   Napi::HandleScope scope(env);
 
   this->m_canalif.m_bQuit = true; // Quit the main loop
-  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  this->m_cyclic.stop();          // No more periodic sends
+  this->m_stream.stop(env);       // End frame stream
+  this->stopStatusWatch();        // No more status polls
+  this->stopBroadcast();          // End broadcast and its readers
+
+  // The listener thread may be in the driver for up to
+  // receiveTimeout before it sees the quit flag
+  while (m_bListenerRunning) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
   int rv = this->m_canalif.CanalClose();
   return Napi::Number::New(env, rv);
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// dataToMsg
+//
+// Copy frame data from a Buffer/Uint8Array with one memcpy or from
+// an array of numbers. Never more than a CAN frame can hold. Returns
+// false if data is neither.
+//
+
+static bool dataToMsg(Napi::Value data, canalMsg *pmsg) {
+
+  if (data.IsTypedArray()) {
+    Napi::TypedArray typed = data.As<Napi::TypedArray>();
+    if ((napi_uint8_array != typed.TypedArrayType()) &&
+        (napi_uint8_clamped_array != typed.TypedArrayType())) {
+      return false;
+    }
+    Napi::Uint8Array bytes = data.As<Napi::Uint8Array>();
+    size_t size = bytes.ElementLength();
+    pmsg->sizeData = (size > 8) ? 8 : (uint8_t)size;
+    memcpy(pmsg->data, bytes.Data(), pmsg->sizeData);
+    return true;
+  }
+
+  if (data.IsArray()) {
+    Napi::Array data_array = data.As<Napi::Array>();
+    uint32_t size = data_array.Length();
+    pmsg->sizeData = (size > 8) ? 8 : size;
+    for (uint32_t i = 0; i < pmsg->sizeData; i++) {
+      Napi::Value val = data_array[i];
+      if (val.IsNumber()) {
+        pmsg->data[i] = (int)val.As<Napi::Number>();
+      }
+    }
+    return true;
+  }
+
+  return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// objectToMsg
+//
+// Fill in a CAN message from a JS message object
+// { id: 12132, flags: 0, ext: true, rtr: false, obid: 0, timestamp: 0,
+//   data: [1,2,3] }
+// data can also be a Buffer or Uint8Array. It may only be left out for
+// remote frames or with an explicit sizeData of 0. Returns false if the
+// object does not describe a valid frame.
+//
+
+static bool objectToMsg(Napi::Object msg, canalMsg *pmsg) {
+
+  const msgKeys &keys = msg.Env().GetInstanceData<addonData>()->keys;
+
+  memset(pmsg, 0, sizeof(canalMsg));
+
+  pmsg->flags = (uint32_t)msg.Get(keys.flags.Value()).ToNumber();
+    
+  bool ext = (bool)msg.Get(keys.ext.Value()).ToBoolean();
+  if (ext) {
+    pmsg->flags |= CANAL_IDFLAG_EXTENDED;
+  }
+    
+  bool rtr = (bool)msg.Get(keys.rtr.Value()).ToBoolean();
+  if (rtr) {
+    pmsg->flags |= CANAL_IDFLAG_RTR;
+  }
+
+  pmsg->timestamp = (uint32_t)msg.Get(keys.timestamp.Value()).ToNumber();
+  pmsg->obid = (uint32_t)msg.Get(keys.obid.Value()).ToNumber();
+  pmsg->id = (uint32_t)msg.Get(keys.id.Value()).ToNumber();
+
+  Napi::Value data = msg.Get(keys.data.Value());
+  Napi::Value size = msg.Get(keys.sizeData.Value());
+  if (data.IsUndefined() || data.IsNull()) {
+    if (!(pmsg->flags & CANAL_IDFLAG_RTR) &&
+        !(size.IsNumber() && (0 == size.As<Napi::Number>().Uint32Value()))) {
+      return false;
+    }
+  } else if (!dataToMsg(data, pmsg)) {
+    return false;
+  }
+
+  // Never more than a CAN frame can hold
+  if (!size.IsUndefined()) {
+    uint32_t sizeData = (uint32_t)size.ToNumber();
+    pmsg->sizeData = (sizeData > 8) ? 8 : sizeData;
+  }
+
+  return true;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // send
 //
@@ -245,75 +635,83 @@ Napi::Value CNodeCanal::send(const Napi::CallbackInfo &info) {
 
   canalMsg canmsg;
   memset(&canmsg, 0, sizeof(canalMsg));
+  uint8_t priority = TXQUEUE_PRIORITY_DEFAULT;
 
   if (5 == info.Length()) {
     
-    // flags, id, data
-    if (info[0].IsNumber() || info[1].IsNumber() || info[2].IsNumber() ||
-        info[3].IsObject()) {
-
-      Napi::Number flags = info[0].As<Napi::Number>();
-      Napi::Number obid = info[1].As<Napi::Number>();
-      Napi::Number timestamp = info[2].As<Napi::Number>();
-      Napi::Number id = info[3].As<Napi::Number>();
-      Napi::Array data_array = info[4].As<Napi::Array>();
-
-      memset(&canmsg, 0, sizeof(canmsg));
-      canmsg.flags = (uint32_t)flags.ToNumber();
-      canmsg.obid = (uint32_t)obid.ToNumber();
-      canmsg.timestamp = (uint32_t)timestamp.ToNumber();
-      canmsg.id = (uint32_t)id.ToNumber();
-      for (uint32_t i = 0; i < data_array.Length(); i++) {
-        Napi::Value val = data_array[i];
-        if (val.IsNumber()) {
-          canmsg.data[i] = (int)val.As<Napi::Number>();
-        }
-      }
-    } else {
+    // flags, obid, timestamp, id, data
+    if (!info[0].IsNumber() || !info[1].IsNumber() || !info[2].IsNumber() ||
+        !info[3].IsNumber() || !dataToMsg(info[4], &canmsg)) {
       Napi::TypeError::New(
-          env, "Five arguments expected (flags,obid,timestamp,id,data-array) or object")
+          env, "Five arguments expected (flags,obid,timestamp,id,data) or object")
           .ThrowAsJavaScriptException();
+      return Napi::Number::New(env, CANAL_ERROR_PARAMETER);
     }
+
+    canmsg.flags = info[0].As<Napi::Number>().Uint32Value();
+    canmsg.obid = info[1].As<Napi::Number>().Uint32Value();
+    canmsg.timestamp = info[2].As<Napi::Number>().Uint32Value();
+    canmsg.id = info[3].As<Napi::Number>().Uint32Value();
   }
   // { id: 12132, ... }
   else if (1 == info.Length() && info[0].IsObject()) {
     
-    Napi::Object msg = info[0].As<Napi::Object>();
-    canmsg.flags = (uint32_t)msg.Get("flags").ToNumber();
-    
-    bool ext = (bool)msg.Get("ext").ToBoolean();
-    if (ext) {
-      canmsg.flags |= CANAL_IDFLAG_EXTENDED;
-    }
-    
-    bool rtr = (bool)msg.Get("rtr").ToBoolean();
-    if (rtr) {
-      canmsg.flags |= CANAL_IDFLAG_RTR;
+    Napi::Object obj = info[0].As<Napi::Object>();
+    if (!objectToMsg(obj, &canmsg)) {
+      Napi::TypeError::New(env, "Invalid frame, data must be an array, Buffer or Uint8Array")
+          .ThrowAsJavaScriptException();
+      return Napi::Number::New(env, CANAL_ERROR_PARAMETER);
     }
 
-    canmsg.timestamp = (uint32_t)msg.Get("timestamp").ToNumber();
-    canmsg.obid = (uint32_t)msg.Get("obid").ToNumber();
-    canmsg.id = (uint32_t)msg.Get("id").ToNumber();
-    Napi::Array data_array = msg.Get("data").ToObject().As<Napi::Array>();
-    if ( msg.Has("sizeData") ) {
-      canmsg.sizeData = (uint32_t)msg.Get("sizeData").ToNumber();
-    }
-    else {
-      canmsg.sizeData = (uint32_t)data_array.Length();
-    }
-    for (uint32_t i = 0; i < canmsg.sizeData; i++) {
-      Napi::Value val = data_array[i];
-      if (val.IsNumber()) {
-        canmsg.data[i] = (int)val.As<Napi::Number>();
-      }
+    // Priority class in the async send queue
+    const msgKeys &keys = env.GetInstanceData<addonData>()->keys;
+    Napi::Value value = obj.Get(keys.priority.Value());
+    if (value.IsNumber()) {
+      uint32_t prio = (uint32_t)value.As<Napi::Number>();
+      priority = (prio > TXQUEUE_PRIORITY_LOWEST) ? TXQUEUE_PRIORITY_LOWEST : prio;
     }
   } else {
     Napi::TypeError::New(
-        env, "Four arguments expected (flags,id,data-array) or object")
+        env, "Five arguments expected (flags,obid,timestamp,id,data) or object")
+        .ThrowAsJavaScriptException();
+    return Napi::Number::New(env, CANAL_ERROR_PARAMETER);
+  }
+
+  int rv = this->m_canalif.CanalSend(&canmsg, priority);
+  return Napi::Number::New(env, rv);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sendRaw
+//
+// sendRaw(id, flags[, data[, priority]])
+//
+
+Napi::Value CNodeCanal::sendRaw(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  canalMsg canmsg;
+  memset(&canmsg, 0, sizeof(canalMsg));
+
+  if ((info.Length() < 2) || (info.Length() > 4) ||
+      !info[0].IsNumber() || !info[1].IsNumber() ||
+      ((info.Length() > 2) && !info[2].IsUndefined() && !dataToMsg(info[2], &canmsg)) ||
+      ((info.Length() > 3) && !info[3].IsNumber())) {
+    Napi::TypeError::New(env, "Two to four arguments expected (id, flags[, data[, priority]])")
         .ThrowAsJavaScriptException();
+    return Napi::Number::New(env, CANAL_ERROR_PARAMETER);
+  }
+
+  canmsg.id = info[0].As<Napi::Number>().Uint32Value();
+  canmsg.flags = info[1].As<Napi::Number>().Uint32Value();
+
+  uint8_t priority = TXQUEUE_PRIORITY_DEFAULT;
+  if (info.Length() > 3) {
+    uint32_t prio = info[3].As<Napi::Number>().Uint32Value();
+    priority = (prio > TXQUEUE_PRIORITY_LOWEST) ? TXQUEUE_PRIORITY_LOWEST : prio;
   }
 
-  int rv = this->m_canalif.CanalSend(&canmsg);
+  int rv = m_canalif.CanalSend(&canmsg, priority);
   return Napi::Number::New(env, rv);
 }
 
@@ -361,6 +759,165 @@ Napi::Value CNodeCanal::receive(const Napi::CallbackInfo &info) {
   return Napi::Number::New(env, rv);
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// msgToRecord
+//
+// Write a frame as a RECORD_SIZE byte record
+//
+
+static void msgToRecord(const canalMsg *pmsg, uint8_t *p) {
+
+  uint8_t size = (pmsg->sizeData > 8) ? 8 : pmsg->sizeData;
+  uint32_t id = pmsg->id;
+  uint32_t flags = pmsg->flags;
+  uint32_t obid = pmsg->obid;
+  uint32_t timestamp = pmsg->timestamp;
+
+  memset(p, 0, RECORD_SIZE);
+  memcpy(p + RECORD_OFFSET_ID, &id, 4);
+  memcpy(p + RECORD_OFFSET_FLAGS, &flags, 4);
+  memcpy(p + RECORD_OFFSET_OBID, &obid, 4);
+  memcpy(p + RECORD_OFFSET_TIMESTAMP, &timestamp, 4);
+  memcpy(p + RECORD_OFFSET_DATA, pmsg->data, size);
+  p[RECORD_OFFSET_SIZE] = size;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// receiveInto
+//
+// receiveInto(view[, offset])
+//
+
+Napi::Value CNodeCanal::receiveInto(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if ((info.Length() < 1) || (info.Length() > 2) ||
+      !(info[0].IsTypedArray() || info[0].IsDataView() || info[0].IsArrayBuffer()) ||
+      ((2 == info.Length()) && !info[1].IsNumber())) {
+    Napi::TypeError::New(env, "One or two arguments expected (view[, offset])")
+        .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  // Bytes of the view
+  uint8_t *pbuf;
+  size_t length;
+  if (info[0].IsTypedArray()) {
+    Napi::TypedArray arr = info[0].As<Napi::TypedArray>();
+    pbuf = (uint8_t *)arr.ArrayBuffer().Data() + arr.ByteOffset();
+    length = arr.ByteLength();
+  }
+  else if (info[0].IsDataView()) {
+    Napi::DataView view = info[0].As<Napi::DataView>();
+    pbuf = (uint8_t *)view.Data();
+    length = view.ByteLength();
+  }
+  else {
+    Napi::ArrayBuffer buf = info[0].As<Napi::ArrayBuffer>();
+    pbuf = (uint8_t *)buf.Data();
+    length = buf.ByteLength();
+  }
+
+  // Byte offset of first record
+  size_t offset = 0;
+  if (2 == info.Length()) {
+    offset = info[1].As<Napi::Number>().Uint32Value();
+  }
+
+  size_t max = (offset < length) ? (length - offset) / RECORD_SIZE : 0;
+
+  int rv = CANAL_ERROR_SUCCESS;
+  uint32_t cnt = 0;
+  canalMsg canmsg;
+  while (cnt < max) {
+    rv = m_canalif.CanalReceive(&canmsg);
+    if (CANAL_ERROR_SUCCESS != rv) {
+      break;
+    }
+    msgToRecord(&canmsg, pbuf + offset + cnt * RECORD_SIZE);
+    cnt++;
+  }
+
+  // An empty driver is not an error
+  if ((0 == cnt) &&
+      (CANAL_ERROR_SUCCESS != rv) && (CANAL_ERROR_FIFO_EMPTY != rv)) {
+    return Napi::Number::New(env, -rv);
+  }
+
+  return Napi::Number::New(env, cnt);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// receiveMany
+//
+// receiveMany([max][, callback])
+//
+
+Napi::Value CNodeCanal::receiveMany(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  size_t argc = info.Length();
+  bool bCallback = (argc > 0) && info[argc - 1].IsFunction();
+  size_t argcMax = bCallback ? argc - 1 : argc;
+
+  if ((argcMax > 1) || ((1 == argcMax) && !info[0].IsNumber())) {
+    Napi::TypeError::New(env, "Zero to two arguments expected ([max][, callback])")
+        .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  uint32_t max = m_canalif.m_config.batchSize;
+  if (1 == argcMax) {
+    max = info[0].As<Napi::Number>().Uint32Value();
+    if (0 == max) {
+      max = 1;
+    }
+  }
+
+  // Drain the driver in one call from JS
+  int rv = CANAL_ERROR_SUCCESS;
+  uint32_t cnt = 0;
+  std::vector<canalMsg> frames;
+  canalMsg canmsg;
+  while (cnt < max) {
+    rv = m_canalif.CanalReceive(&canmsg);
+    if (CANAL_ERROR_SUCCESS != rv) {
+      break;
+    }
+    frames.push_back(canmsg);
+    cnt++;
+  }
+
+  // Same format as the listener delivers
+  Napi::Value result;
+  if (m_bColumnar) {
+    result = framesToColumns(env, frames.data(), frames.size());
+  }
+  else {
+    Napi::Array arr = Napi::Array::New(env, cnt);
+    for (uint32_t i = 0; i < cnt; i++) {
+      arr[i] = msgToObject(env, &frames[i]);
+    }
+    result = arr;
+  }
+
+  if (!bCallback) {
+    // An empty array must mean nothing was waiting
+    if ((0 == cnt) && (CANAL_ERROR_FIFO_EMPTY != rv)) {
+      Napi::Error err = Napi::Error::New(env, "Failed to read from the driver");
+      err.Value().Set("code", rv);
+      err.ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+    return result;
+  }
+
+  Napi::Function cb = info[argc - 1].As<Napi::Function>();
+  cb.MakeCallback(env.Global(), {result});
+
+  return Napi::Number::New(env, cnt ? CANAL_ERROR_SUCCESS : rv);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // getStatus
 //
@@ -387,10 +944,7 @@ Napi::Value CNodeCanal::getStatus(const Napi::CallbackInfo &info) {
   memset(&canStatus,0,sizeof(canalStatus));
   uint32_t rv = this->m_canalif.CanalGetStatus(&canStatus);
   if (CANAL_ERROR_SUCCESS == rv) {
-    obj.Set("Channel_Status", uint32_t(canStatus.channel_status));
-    obj.Set("LastErrorCode", uint32_t(canStatus.lasterrorcode));
-    obj.Set("LastErrorSubCode", uint32_t(canStatus.lasterrorsubcode));
-    obj.Set("LastErrorStr", canStatus.lasterrorstr);
+    obj = statusToObject(env, &canStatus);
   }
 
   Napi::Function cb = info[0].As<Napi::Function>();
@@ -424,13 +978,7 @@ Napi::Value CNodeCanal::getStatistics(const Napi::CallbackInfo &info) {
   memset(&canStatistics,0,sizeof(canalStatistics));
   uint32_t rv = this->m_canalif.CanalGetStatistics(&canStatistics);
   if (CANAL_ERROR_SUCCESS == rv) {
-    obj.Set("cntReceiveFrames", uint32_t(canStatistics.cntReceiveFrames));
-    obj.Set("cntTransmitFrames", uint32_t(canStatistics.cntTransmitFrames));
-    obj.Set("cntReceiveData", uint32_t(canStatistics.cntReceiveData));
-    obj.Set("cntTransmitData", uint32_t(canStatistics.cntTransmitData));
-    obj.Set("cntOverruns", uint32_t(canStatistics.cntOverruns));
-    obj.Set("cntBusWarnings", uint32_t(canStatistics.cntBusWarnings));
-    obj.Set("cntBusOff", uint32_t(canStatistics.cntBusOff));
+    obj = statisticsToObject(env, &canStatistics);
   }
 
   Napi::Function cb = info[0].As<Napi::Function>();
@@ -566,38 +1114,1931 @@ Napi::Value CNodeCanal::getDriverInfo(const Napi::CallbackInfo &info) {
   return Napi::String::New(env, pDriverInfoStr);
 }
 
-// The thread-safe function finalizer callback. This callback executes
-// at destruction of thread-safe function, taking as arguments the finalizer
-// data and threadsafe-function context.
-void finalizerCallback( Napi::Env env, 
-                          void *finalizeData,
-                          tsfnContext *context ) {
-  // Join the thread
-  context->workThread.join();
-
-  // Resolve the Promise previously returned to JS via the CreateTSFN method.
-  context->deferred.Resolve(Napi::Boolean::New(env, true));
-  delete context;
-};
-
 ///////////////////////////////////////////////////////////////////////////////
-// addListener
+// enableJ1939
 //
 
-bool CNodeCanal::addListener(Napi::Env &env,
-                                    Napi::Function &callback) 
-{
-  napi_value work_name;
+Napi::Value CNodeCanal::enableJ1939(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
 
-  // This string describes the asynchronous work.
-  napi_create_string_utf8( env, 
-                            "addListner",
-                            NAPI_AUTO_LENGTH, 
-                            &work_name);
+  std::vector<uint32_t> pgns;
 
-  // Construct context data
-  auto context = new tsfnContext(env); 
+  if (info.Length() > 1) {
+    Napi::TypeError::New(env, "Invalid argument count")
+        .ThrowAsJavaScriptException();
+    return Napi::Number::New(env, CANAL_ERROR_PARAMETER);
+  }
+
+  if (1 == info.Length()) {
+    if (!info[0].IsArray()) {
+      Napi::TypeError::New(env, "Invalid argument type (expect array of PGN's)")
+          .ThrowAsJavaScriptException();
+      return Napi::Number::New(env, CANAL_ERROR_PARAMETER);
+    }
+
+    arrayToVector(info[0], pgns);
+  }
+
+  // Decoded messages do not fit the column layout
+  if (m_bColumnar) {
+    Napi::Error err = Napi::Error::New(env, "J1939 decoding is not supported with the columnar delivery format");
+    err.Value().Set("code", CANAL_ERROR_NOT_SUPPORTED);
+    err.ThrowAsJavaScriptException();
+    return Napi::Number::New(env, CANAL_ERROR_NOT_SUPPORTED);
+  }
+
+  m_j1939.setPgnFilter(pgns);
+  m_j1939.enable(true);
+
+  return Napi::Number::New(env, CANAL_ERROR_SUCCESS);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// disableJ1939
+//
+
+Napi::Value CNodeCanal::disableJ1939(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  m_j1939.enable(false);
+
+  return Napi::Number::New(env, CANAL_ERROR_SUCCESS);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getJ1939Statistics
+//
+
+Napi::Value CNodeCanal::getJ1939Statistics(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  Napi::Object obj = Napi::Object::New(env);
+  obj.Set("cntCompleted", uint32_t(m_j1939.m_cntCompleted));
+  obj.Set("cntAborted", uint32_t(m_j1939.m_cntAborted));
+  obj.Set("cntTimedOut", uint32_t(m_j1939.m_cntTimedOut));
+  obj.Set("cntFiltered", uint32_t(m_j1939.m_cntFiltered));
+
+  return obj;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// enableVscp
+//
+
+Napi::Value CNodeCanal::enableVscp(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  std::vector<uint32_t> classes;
+  std::vector<uint32_t> types;
+  std::vector<uint32_t> nicknames;
+
+  if (info.Length() > 1) {
+    Napi::TypeError::New(env, "Invalid argument count")
+        .ThrowAsJavaScriptException();
+    return Napi::Number::New(env, CANAL_ERROR_PARAMETER);
+  }
+
+  if (1 == info.Length()) {
+    if (!info[0].IsObject()) {
+      Napi::TypeError::New(env, "Invalid argument type (expect object)")
+          .ThrowAsJavaScriptException();
+      return Napi::Number::New(env, CANAL_ERROR_PARAMETER);
+    }
+
+    Napi::Object filter = info[0].As<Napi::Object>();
+    arrayToVector(filter.Get("classes"), classes);
+    arrayToVector(filter.Get("types"), types);
+    arrayToVector(filter.Get("nicknames"), nicknames);
+  }
+
+  // Decoded messages do not fit the column layout
+  if (m_bColumnar) {
+    Napi::Error err = Napi::Error::New(env, "VSCP decoding is not supported with the columnar delivery format");
+    err.Value().Set("code", CANAL_ERROR_NOT_SUPPORTED);
+    err.ThrowAsJavaScriptException();
+    return Napi::Number::New(env, CANAL_ERROR_NOT_SUPPORTED);
+  }
+
+  m_vscp.setFilter(classes, types, nicknames);
+  m_vscp.enable(true);
+
+  return Napi::Number::New(env, CANAL_ERROR_SUCCESS);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// disableVscp
+//
+
+Napi::Value CNodeCanal::disableVscp(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  m_vscp.enable(false);
+
+  return Napi::Number::New(env, CANAL_ERROR_SUCCESS);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// toMicroseconds
+//
+// Convert a JS time in microseconds. Throws a RangeError and returns
+// false if it is negative, not finite or too large to be exact.
+//
+
+static bool toMicroseconds(Napi::Env env, Napi::Value value, const char *name, uint64_t &us) {
+
+  double val = value.As<Napi::Number>().DoubleValue();
+  if (!isfinite(val) || (val < 0) || (val > 9007199254740991.0)) {
+    Napi::RangeError::New(env, std::string(name) + " must be a finite number, zero or more")
+        .ThrowAsJavaScriptException();
+    return false;
+  }
+
+  us = (uint64_t)val;
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// addCyclic
+//
+
+Napi::Value CNodeCanal::addCyclic(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if ((info.Length() < 2) || (info.Length() > 3)) {
+    Napi::TypeError::New(env, "Two or three arguments expected (frame, periodUs[, options])")
+        .ThrowAsJavaScriptException();
+    return Napi::Number::New(env, 0);
+  }
+
+  if (!info[0].IsObject() || !info[1].IsNumber() || 
+      ((3 == info.Length()) && !info[2].IsObject())) {
+    Napi::TypeError::New(env, "Two or three arguments expected (frame, periodUs[, options])")
+        .ThrowAsJavaScriptException();
+    return Napi::Number::New(env, 0);
+  }
+
+  canalMsg canmsg;
+  if (!objectToMsg(info[0].As<Napi::Object>(), &canmsg)) {
+    Napi::TypeError::New(env, "Invalid frame, data must be an array, Buffer or Uint8Array")
+        .ThrowAsJavaScriptException();
+    return Napi::Number::New(env, 0);
+  }
+
+  uint64_t period;
+  uint64_t delay = 0;
+  uint32_t count = 0;
+
+  if (!toMicroseconds(env, info[1], "periodUs", period)) {
+    return Napi::Number::New(env, 0);
+  }
+
+  if (3 == info.Length()) {
+    Napi::Object options = info[2].As<Napi::Object>();
+    if (options.Get("delayUs").IsNumber() &&
+        !toMicroseconds(env, options.Get("delayUs"), "delayUs", delay)) {
+      return Napi::Number::New(env, 0);
+    }
+    if (options.Get("count").IsNumber()) {
+      count = (uint32_t)options.Get("count").As<Napi::Number>();
+    }
+  }
+
+  if (period < CYCLIC_MIN_PERIOD_US) {
+    Napi::RangeError::New(env, "Period must be at least 100 us")
+        .ThrowAsJavaScriptException();
+    return Napi::Number::New(env, 0);
+  }
+
+  uint32_t id = m_cyclic.add(&canmsg, period, delay, count);
+  return Napi::Number::New(env, id);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// updateCyclic
+//
+
+Napi::Value CNodeCanal::updateCyclic(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if ((info.Length() < 2) || (info.Length() > 3)) {
+    Napi::TypeError::New(env, "Two or three arguments expected (id, frame[, periodUs])")
+        .ThrowAsJavaScriptException();
+    return Napi::Number::New(env, CANAL_ERROR_PARAMETER);
+  }
+
+  if (!info[0].IsNumber() || 
+      (!info[1].IsObject() && !info[1].IsNull() && !info[1].IsUndefined()) ||
+      ((3 == info.Length()) && !info[2].IsNumber())) {
+    Napi::TypeError::New(env, "Two or three arguments expected (id, frame[, periodUs])")
+        .ThrowAsJavaScriptException();
+    return Napi::Number::New(env, CANAL_ERROR_PARAMETER);
+  }
+
+  uint32_t id = (uint32_t)info[0].As<Napi::Number>();
+  uint64_t period = 0;
+  if ((3 == info.Length()) &&
+      !toMicroseconds(env, info[2], "periodUs", period)) {
+    return Napi::Number::New(env, CANAL_ERROR_PARAMETER);
+  }
+
+  canalMsg canmsg;
+  canalMsg *pmsg = NULL;
+  if (info[1].IsObject()) {
+    if (!objectToMsg(info[1].As<Napi::Object>(), &canmsg)) {
+      Napi::TypeError::New(env, "Invalid frame, data must be an array, Buffer or Uint8Array")
+          .ThrowAsJavaScriptException();
+      return Napi::Number::New(env, CANAL_ERROR_PARAMETER);
+    }
+    pmsg = &canmsg;
+  }
+
+  int rv = m_cyclic.update(id, pmsg, period);
+  return Napi::Number::New(env, rv);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// removeCyclic
+//
+
+Napi::Value CNodeCanal::removeCyclic(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if ((1 != info.Length()) || !info[0].IsNumber()) {
+    Napi::TypeError::New(env, "One argument expected (id)")
+        .ThrowAsJavaScriptException();
+    return Napi::Number::New(env, CANAL_ERROR_PARAMETER);
+  }
+
+  int rv = m_cyclic.remove((uint32_t)info[0].As<Napi::Number>());
+  return Napi::Number::New(env, rv);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getCyclicStatistics
+//
+
+Napi::Value CNodeCanal::getCyclicStatistics(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if ((1 != info.Length()) || !info[0].IsNumber()) {
+    Napi::TypeError::New(env, "One argument expected (id)")
+        .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  cyclicStatistics stat;
+  if (CANAL_ERROR_SUCCESS != 
+        m_cyclic.getStatistics((uint32_t)info[0].As<Napi::Number>(), &stat)) {
+    return env.Undefined();
+  }
+
+  Napi::Object obj = Napi::Object::New(env);
+  obj.Set("cntSent", stat.cntSent);
+  obj.Set("cntErrors", stat.cntErrors);
+  obj.Set("cntMissed", stat.cntMissed);
+  obj.Set("lastError", stat.lastError);
+  obj.Set("periodUs", double(stat.periodUs));
+  obj.Set("minJitterUs", stat.minJitterUs);
+  obj.Set("maxJitterUs", stat.maxJitterUs);
+  obj.Set("avgJitterUs", stat.avgJitterUs);
+
+  return obj;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sendAndWait
+//
+
+Napi::Value CNodeCanal::sendAndWait(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if ((info.Length() < 1) || (info.Length() > 2) || !info[0].IsObject() ||
+      ((2 == info.Length()) && !info[1].IsObject())) {
+    Napi::TypeError::New(env, "One or two arguments expected (frame[, options])")
+        .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  canalMsg canmsg;
+  if (!objectToMsg(info[0].As<Napi::Object>(), &canmsg)) {
+    Napi::TypeError::New(env, "Invalid frame, data must be an array, Buffer or Uint8Array")
+        .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  // Default is a response with the same id and id type
+  requestMatch match;
+  memset(&match, 0, sizeof(requestMatch));
+  match.id = canmsg.id;
+  match.mask = CAN_MAX_EXTENDED_ID;
+  match.flags = canmsg.flags & CANAL_IDFLAG_EXTENDED;
+  match.flagsMask = CANAL_IDFLAG_EXTENDED;
+  uint32_t timeout = 1000;
+
+  if (2 == info.Length()) {
+    Napi::Object options = info[1].As<Napi::Object>();
+    if (options.Get("matchId").IsNumber()) {
+      match.id = (uint32_t)options.Get("matchId").As<Napi::Number>();
+    }
+    if (options.Get("matchMask").IsNumber()) {
+      match.mask = (uint32_t)options.Get("matchMask").As<Napi::Number>();
+    }
+    if (options.Get("matchFlags").IsNumber()) {
+      match.flags = (uint32_t)options.Get("matchFlags").As<Napi::Number>();
+      match.flagsMask = CANAL_IDFLAG_EXTENDED | CANAL_IDFLAG_RTR;
+    }
+    if (options.Get("matchFlagsMask").IsNumber()) {
+      match.flagsMask = (uint32_t)options.Get("matchFlagsMask").As<Napi::Number>();
+    }
+    if (options.Get("timeoutMs").IsNumber()) {
+      timeout = (uint32_t)options.Get("timeoutMs").As<Napi::Number>();
+    }
+
+    // null/undefined entries are don't care
+    if (options.Get("matchBytes").IsArray()) {
+      Napi::Array bytes = options.Get("matchBytes").As<Napi::Array>();
+      for (uint32_t i = 0; (i < bytes.Length()) && (i < 8); i++) {
+        Napi::Value val = bytes[i];
+        if (val.IsNumber()) {
+          match.data[i] = (uint32_t)val.As<Napi::Number>();
+          match.dataMask |= (1 << i);
+        }
+      }
+    }
+  }
+
+  waitContext *pwait = new waitContext(env);
+  Napi::Promise promise = pwait->deferred.Promise();
+
+  // The matcher lives in the listener thread
+  if (!m_bListening || m_canalif.m_bQuit) {
+    Napi::Error err = Napi::Error::New(env, "sendAndWait needs a listener (init with callback)");
+    err.Value().Set("code", CANAL_ERROR_NOT_SUPPORTED);
+    pwait->deferred.Reject(err.Value());
+    delete pwait;
+    return promise;
+  }
+
+  // Must be waiting before the request is sent
+  m_matcher.add(&match, timeout, pwait);
+
+  int rv = m_canalif.CanalSend(&canmsg);
+  if ((CANAL_ERROR_SUCCESS != rv) && m_matcher.remove(pwait)) {
+    Napi::Error err = Napi::Error::New(env, "Failed to send request");
+    err.Value().Set("code", rv);
+    pwait->deferred.Reject(err.Value());
+    delete pwait;
+  }
+
+  return promise;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// openAsync
+//
+
+Napi::Value CNodeCanal::openAsync(const Napi::CallbackInfo &info) {
+
+  COpenWorker *pworker = new COpenWorker(Value(), &m_canalif);
+  Napi::Promise promise = pworker->Promise();
+  pworker->Queue();
+
+  return promise;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// closeAsync
+//
+
+Napi::Value CNodeCanal::closeAsync(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  this->m_canalif.m_bQuit = true; // Quit the main loop
+  this->m_cyclic.stop();          // No more periodic sends
+  this->m_stream.stop(env);       // End frame stream
+  this->stopStatusWatch();        // No more status polls
+  this->stopBroadcast();          // End broadcast and its readers
+
+  CCloseWorker *pworker = new CCloseWorker(Value(), &m_canalif, &m_bListenerRunning);
+  Napi::Promise promise = pworker->Promise();
+  pworker->Queue();
+
+  return promise;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getStatusAsync
+//
+
+Napi::Value CNodeCanal::getStatusAsync(const Napi::CallbackInfo &info) {
+
+  CGetStatusWorker *pworker = new CGetStatusWorker(Value(), &m_canalif);
+  Napi::Promise promise = pworker->Promise();
+  pworker->Queue();
+
+  return promise;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getStatisticsAsync
+//
+
+Napi::Value CNodeCanal::getStatisticsAsync(const Napi::CallbackInfo &info) {
+
+  CGetStatisticsWorker *pworker = new CGetStatisticsWorker(Value(), &m_canalif);
+  Napi::Promise promise = pworker->Promise();
+  pworker->Queue();
+
+  return promise;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// setBaudrateAsync
+//
+
+Napi::Value CNodeCanal::setBaudrateAsync(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if ((1 != info.Length()) || !info[0].IsNumber()) {
+    Napi::TypeError::New(env, "One argument expected (baudrate)")
+        .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  uint32_t baud = (uint32_t)info[0].As<Napi::Number>();
+  CSetBaudrateWorker *pworker = new CSetBaudrateWorker(Value(), &m_canalif, baud);
+  Napi::Promise promise = pworker->Promise();
+  pworker->Queue();
+
+  return promise;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// receiveAsync
+//
+
+Napi::Value CNodeCanal::receiveAsync(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if ((info.Length() > 1) || 
+      ((1 == info.Length()) && !info[0].IsNumber())) {
+    Napi::TypeError::New(env, "Zero or one argument expected ([timeoutMs])")
+        .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  // Zero would block a libuv pool thread forever
+  uint32_t timeout = 1000;
+  if (1 == info.Length()) {
+    timeout = (uint32_t)info[0].As<Napi::Number>();
+    if (0 == timeout) {
+      timeout = 1;
+    }
+  }
+
+  CReceiveWorker *pworker = new CReceiveWorker(Value(), &m_canalif, timeout);
+  Napi::Promise promise = pworker->Promise();
+  pworker->Queue();
+
+  return promise;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// startStream
+//
+
+Napi::Value CNodeCanal::startStream(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if ((info.Length() > 1) ||
+      ((1 == info.Length()) && !info[0].IsObject())) {
+    Napi::TypeError::New(env, "Zero or one argument expected ([options])")
+        .ThrowAsJavaScriptException();
+    return Napi::Number::New(env, CANAL_ERROR_PARAMETER);
+  }
+
+  // The listener, the broadcast and the stream would compete for frames
+  if (m_bListening || m_bBroadcastOwner) {
+    return Napi::Number::New(env, CANAL_ERROR_NOT_SUPPORTED);
+  }
+
+  if (m_canalif.m_bQuit) {
+    return Napi::Number::New(env, CANAL_ERROR_NOT_OPEN);
+  }
+
+  uint32_t capacity = m_canalif.m_config.streamCapacity;
+  if (1 == info.Length()) {
+    Napi::Object options = info[0].As<Napi::Object>();
+    if (options.Get("capacity").IsNumber()) {
+      capacity = (uint32_t)options.Get("capacity").As<Napi::Number>();
+    }
+  }
+
+  int rv = m_stream.start(env, &m_canalif, capacity);
+  return Napi::Number::New(env, rv);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// readBatch
+//
+
+Napi::Value CNodeCanal::readBatch(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if ((info.Length() > 2) ||
+      ((info.Length() >= 1) && !info[0].IsNumber()) ||
+      ((2 == info.Length()) && !info[1].IsNumber())) {
+    Napi::TypeError::New(env, "Zero to two arguments expected ([batchSize, maxLatencyMs])")
+        .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  uint32_t batchSize = m_canalif.m_config.batchSize;
+  uint32_t maxLatency = 10;
+  if (info.Length() >= 1) {
+    batchSize = (uint32_t)info[0].As<Napi::Number>();
+  }
+  if (2 == info.Length()) {
+    maxLatency = (uint32_t)info[1].As<Napi::Number>();
+  }
+
+  return m_stream.read(env, batchSize, maxLatency);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// readColumns
+//
+
+Napi::Value CNodeCanal::readColumns(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if ((info.Length() > 2) ||
+      ((info.Length() >= 1) && !info[0].IsNumber()) ||
+      ((2 == info.Length()) && !info[1].IsNumber())) {
+    Napi::TypeError::New(env, "Zero to two arguments expected ([batchSize, maxLatencyMs])")
+        .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  uint32_t batchSize = m_canalif.m_config.batchSize;
+  uint32_t maxLatency = 10;
+  if (info.Length() >= 1) {
+    batchSize = (uint32_t)info[0].As<Napi::Number>();
+  }
+  if (2 == info.Length()) {
+    maxLatency = (uint32_t)info[1].As<Napi::Number>();
+  }
+
+  return m_stream.read(env, batchSize, maxLatency, true);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// stopStream
+//
+
+Napi::Value CNodeCanal::stopStream(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  m_stream.stop(env);
+
+  return Napi::Number::New(env, CANAL_ERROR_SUCCESS);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// enableBroadcast
+//
+
+Napi::Value CNodeCanal::enableBroadcast(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if ((info.Length() > 1) ||
+      ((1 == info.Length()) && !info[0].IsObject())) {
+    Napi::TypeError::New(env, "Zero or one argument expected ([options])")
+        .ThrowAsJavaScriptException();
+    return Napi::Number::New(env, CANAL_ERROR_PARAMETER);
+  }
+
+  // The listener, the stream and the broadcast would compete for frames
+  if (m_bListening || m_stream.isRunning()) {
+    return Napi::Number::New(env, CANAL_ERROR_NOT_SUPPORTED);
+  }
+
+  if (m_pbroadcast) {
+    return Napi::Number::New(env, CANAL_ERROR_INIT_READY);
+  }
+
+  uint32_t capacity = m_canalif.m_config.broadcastCapacity;
+  std::string name;
+  if (1 == info.Length()) {
+    Napi::Object options = info[0].As<Napi::Object>();
+    if (options.Get("capacity").IsNumber()) {
+      capacity = (uint32_t)options.Get("capacity").As<Napi::Number>();
+    }
+    if (options.Get("name").IsString()) {
+      name = options.Get("name").As<Napi::String>().Utf8Value();
+    }
+  }
+
+  std::shared_ptr<CBroadcastRing> pring =
+      std::make_shared<CBroadcastRing>(capacity);
+
+  if (!name.empty() && !CBroadcastRing::publish(name, pring)) {
+    return Napi::Number::New(env, CANAL_ERROR_ONLY_ONE_INSTANCE);
+  }
+
+  int rv = pring->start(&m_canalif);
+  if (CANAL_ERROR_SUCCESS != rv) {
+    if (!name.empty()) {
+      CBroadcastRing::unpublish(name);
+    }
+    return Napi::Number::New(env, rv);
+  }
+
+  m_pbroadcast = pring;
+  m_bBroadcastOwner = true;
+  m_broadcastName = name;
+
+  return Napi::Number::New(env, CANAL_ERROR_SUCCESS);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// stopBroadcast
+//
+
+void CNodeCanal::stopBroadcast(void) {
+
+  if (!m_pbroadcast) {
+    return;
+  }
+
+  // Reader threads end when their reader is gone
+  for (uint32_t id : m_readers) {
+    m_pbroadcast->removeReader(id);
+  }
+  m_readers.clear();
+
+  // Joins the thread reading the driver. Readers attached from
+  // other instances end when the ring is closed.
+  if (m_bBroadcastOwner) {
+    m_pbroadcast->stop();
+    if (!m_broadcastName.empty()) {
+      CBroadcastRing::unpublish(m_broadcastName);
+    }
+  }
+
+  m_pbroadcast.reset();
+  m_bBroadcastOwner = false;
+  m_broadcastName.clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// disableBroadcast
+//
+
+Napi::Value CNodeCanal::disableBroadcast(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if (!m_pbroadcast) {
+    return Napi::Number::New(env, CANAL_ERROR_NOT_OPEN);
+  }
+
+  stopBroadcast();
+
+  return Napi::Number::New(env, CANAL_ERROR_SUCCESS);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// attachBroadcast
+//
+
+Napi::Value CNodeCanal::attachBroadcast(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if ((1 != info.Length()) || !info[0].IsString()) {
+    Napi::TypeError::New(env, "One argument expected (name)")
+        .ThrowAsJavaScriptException();
+    return Napi::Number::New(env, CANAL_ERROR_PARAMETER);
+  }
+
+  if (m_pbroadcast) {
+    return Napi::Number::New(env, CANAL_ERROR_INIT_READY);
+  }
+
+  std::shared_ptr<CBroadcastRing> pring =
+      CBroadcastRing::find(info[0].As<Napi::String>().Utf8Value());
+  if (!pring) {
+    return Napi::Number::New(env, CANAL_ERROR_NOT_OPEN);
+  }
+
+  m_pbroadcast = pring;
+  m_bBroadcastOwner = false;
+
+  return Napi::Number::New(env, CANAL_ERROR_SUCCESS);
+}
+
+// Called when a reader's thread-safe function is destroyed
+static void readerFinalizerCallback(Napi::Env env,
+                                      void *finalizeData,
+                                      readerContext *context) {
+  context->workThread.join();
+  delete context;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// addReader
+//
+
+Napi::Value CNodeCanal::addReader(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if ((info.Length() < 1) || (info.Length() > 2) || !info[0].IsFunction() ||
+      ((2 == info.Length()) && !info[1].IsObject())) {
+    Napi::TypeError::New(env, "One or two arguments expected (callback[, options])")
+        .ThrowAsJavaScriptException();
+    return Napi::Number::New(env, 0);
+  }
+
+  if (!m_pbroadcast) {
+    return Napi::Number::New(env, 0);
+  }
+
+  uint32_t maxBacklog = 0;
+  int policy = BROADCAST_POLICY_DROP_OLDEST;
+  uint32_t batchSize = m_canalif.m_config.batchSize;
+  if (2 == info.Length()) {
+    Napi::Object options = info[1].As<Napi::Object>();
+    if (options.Get("maxBacklog").IsNumber()) {
+      maxBacklog = (uint32_t)options.Get("maxBacklog").As<Napi::Number>();
+    }
+    if (options.Get("policy").IsString() &&
+        ("resync" == options.Get("policy").As<Napi::String>().Utf8Value())) {
+      policy = BROADCAST_POLICY_RESYNC;
+    }
+    if (options.Get("batchSize").IsNumber()) {
+      batchSize = (uint32_t)options.Get("batchSize").As<Napi::Number>();
+      if (0 == batchSize) {
+        batchSize = 1;
+      }
+    }
+  }
+
+  readerContext *context = new readerContext;
+  context->m_pring = m_pbroadcast;
+  context->m_id = m_pbroadcast->addReader(maxBacklog, policy);
+  context->m_batchSize = batchSize;
+
+  // A short queue makes a slow JS reader lag in the ring, where its
+  // drop policy applies, instead of queueing frames without limit
+  context->tsfn = Napi::ThreadSafeFunction::New(
+      env,
+      info[0].As<Napi::Function>(),
+      "broadcastReader",
+      2,
+      1,
+      context,
+      readerFinalizerCallback,
+      (void *)nullptr);
+
+  m_readers.push_back(context->m_id);
+
+  auto callback = [](Napi::Env env,
+                      Napi::Function jsCallback,
+                      std::vector<canalMsg> *pbatch) {
+    for (const canalMsg &msg : *pbatch) {
+      jsCallback.Call({msgToObject(env, &msg)});
+    }
+    delete pbatch;
+  };
+
+  context->workThread = std::thread([context, callback] {
+    for (;;) {
+      std::vector<canalMsg> *pbatch =
+          new std::vector<canalMsg>(context->m_batchSize);
+      int cnt = context->m_pring->read(context->m_id,
+                                        pbatch->data(),
+                                        pbatch->size(),
+                                        500);
+      if (cnt <= 0) {
+        delete pbatch;
+        if (cnt < 0) {
+          break;    // Removed or ring closed
+        }
+        continue;
+      }
+
+      pbatch->resize(cnt);
+      if (napi_ok != context->tsfn.BlockingCall(pbatch, callback)) {
+        delete pbatch;
+        break;
+      }
+    }
+
+    context->m_pring->removeReader(context->m_id);
+    context->tsfn.Release();
+  });
+
+  return Napi::Number::New(env, context->m_id);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// removeReader
+//
+
+Napi::Value CNodeCanal::removeReader(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if ((1 != info.Length()) || !info[0].IsNumber()) {
+    Napi::TypeError::New(env, "One argument expected (id)")
+        .ThrowAsJavaScriptException();
+    return Napi::Number::New(env, CANAL_ERROR_PARAMETER);
+  }
+
+  uint32_t id = (uint32_t)info[0].As<Napi::Number>();
+  auto it = std::find(m_readers.begin(), m_readers.end(), id);
+  if (!m_pbroadcast || (m_readers.end() == it)) {
+    return Napi::Number::New(env, CANAL_ERROR_PARAMETER);
+  }
+
+  // The reader thread quits and releases its callback
+  m_pbroadcast->removeReader(id);
+  m_readers.erase(it);
+
+  return Napi::Number::New(env, CANAL_ERROR_SUCCESS);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getReaderStatistics
+//
+
+Napi::Value CNodeCanal::getReaderStatistics(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if ((1 != info.Length()) || !info[0].IsNumber()) {
+    Napi::TypeError::New(env, "One argument expected (id)")
+        .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  broadcastReaderStatistics stat;
+  if (!m_pbroadcast ||
+      !m_pbroadcast->getReaderStatistics((uint32_t)info[0].As<Napi::Number>(),
+                                          &stat)) {
+    return env.Undefined();
+  }
+
+  Napi::Object obj = Napi::Object::New(env);
+  obj.Set("cntRead", double(stat.cntRead));
+  obj.Set("cntDropped", double(stat.cntDropped));
+  obj.Set("backlog", stat.backlog);
+
+  return obj;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// setReceiveSpin
+//
+
+Napi::Value CNodeCanal::setReceiveSpin(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if ((1 != info.Length()) || !info[0].IsNumber()) {
+    Napi::TypeError::New(env, "One argument expected (spinUs)")
+        .ThrowAsJavaScriptException();
+    return Napi::Number::New(env, CANAL_ERROR_PARAMETER);
+  }
+
+  m_canalif.setReceiveSpin((uint32_t)info[0].As<Napi::Number>());
+
+  return Napi::Number::New(env, CANAL_ERROR_SUCCESS);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getReceiveStatistics
+//
+
+Napi::Value CNodeCanal::getReceiveStatistics(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if ((info.Length() > 1) ||
+      ((1 == info.Length()) && !info[0].IsBoolean())) {
+    Napi::TypeError::New(env, "Zero or one argument expected ([reset])")
+        .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  receiveStatistics stat;
+  m_canalif.getReceiveStatistics(&stat);
+
+  if ((1 == info.Length()) && info[0].As<Napi::Boolean>()) {
+    m_canalif.resetReceiveStatistics();
+  }
+
+  Napi::Object obj = Napi::Object::New(env);
+  obj.Set("cntSpinFrames", double(stat.cntSpinFrames));
+  obj.Set("cntBlockingFrames", double(stat.cntBlockingFrames));
+  obj.Set("cntSpinMisses", double(stat.cntSpinMisses));
+  obj.Set("spinUs", double(stat.spinUs));
+  obj.Set("avgLatencyUs", stat.avgLatencyUs);
+  obj.Set("maxLatencyUs", stat.maxLatencyUs);
+
+  return obj;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// setDeliveryPolicy
+//
+
+Napi::Value CNodeCanal::setDeliveryPolicy(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if ((1 != info.Length()) || !valueToPolicy(info[0], m_coalesce)) {
+    Napi::TypeError::New(env, "One argument expected (\"lowLatency\", \"highThroughput\" or {maxFrames, maxHoldUs})")
+        .ThrowAsJavaScriptException();
+    return Napi::Number::New(env, CANAL_ERROR_PARAMETER);
+  }
+
+  return Napi::Number::New(env, CANAL_ERROR_SUCCESS);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getDeliveryStatistics
+//
+
+Napi::Value CNodeCanal::getDeliveryStatistics(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if ((info.Length() > 1) ||
+      ((1 == info.Length()) && !info[0].IsBoolean())) {
+    Napi::TypeError::New(env, "Zero or one argument expected ([reset])")
+        .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  coalesceStatistics stat;
+  m_coalesce.getStatistics(&stat);
+
+  if ((1 == info.Length()) && info[0].As<Napi::Boolean>()) {
+    m_coalesce.resetStatistics();
+  }
+
+  Napi::Object obj = Napi::Object::New(env);
+  obj.Set("cntBatches", double(stat.cntBatches));
+  obj.Set("cntFrames", double(stat.cntFrames));
+  obj.Set("maxBatch", stat.maxBatch);
+  obj.Set("avgBatch", stat.avgBatch);
+  obj.Set("maxHoldUs", stat.maxHoldUs);
+  obj.Set("avgHoldUs", stat.avgHoldUs);
+
+  return obj;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// setDeliveryFormat
+//
+
+Napi::Value CNodeCanal::setDeliveryFormat(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  std::string format;
+  if ((1 == info.Length()) && info[0].IsString()) {
+    format = info[0].As<Napi::String>().Utf8Value();
+  }
+
+  if (("objects" != format) && ("columnar" != format)) {
+    Napi::TypeError::New(env, "One argument expected (\"objects\" or \"columnar\")")
+        .ThrowAsJavaScriptException();
+    return Napi::Number::New(env, CANAL_ERROR_PARAMETER);
+  }
+
+  // J1939 and VSCP messages can't be delivered as columns
+  if (("columnar" == format) && (m_j1939.isEnabled() || m_vscp.isEnabled())) {
+    Napi::Error err = Napi::Error::New(env, "The columnar delivery format is not supported with J1939 or VSCP decoding enabled");
+    err.Value().Set("code", CANAL_ERROR_NOT_SUPPORTED);
+    err.ThrowAsJavaScriptException();
+    return Napi::Number::New(env, CANAL_ERROR_NOT_SUPPORTED);
+  }
+
+  m_bColumnar = ("columnar" == format);
+
+  return Napi::Number::New(env, CANAL_ERROR_SUCCESS);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// enableIdStatistics
+//
+
+Napi::Value CNodeCanal::enableIdStatistics(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  m_canalif.m_bIdStatistics = true;
+
+  return Napi::Number::New(env, CANAL_ERROR_SUCCESS);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// disableIdStatistics
+//
+
+Napi::Value CNodeCanal::disableIdStatistics(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  m_canalif.m_bIdStatistics = false;
+
+  return Napi::Number::New(env, CANAL_ERROR_SUCCESS);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getIdStatistics
+//
+
+Napi::Value CNodeCanal::getIdStatistics(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if ((info.Length() > 1) ||
+      ((1 == info.Length()) && !info[0].IsBoolean())) {
+    Napi::TypeError::New(env, "Zero or one argument expected ([reset])")
+        .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  bool bReset = (1 == info.Length()) && info[0].As<Napi::Boolean>();
+  uint64_t cntOverflow = m_canalif.m_idStatistics.getOverflow();
+
+  std::vector<idStatistics> stats;
+  m_canalif.m_idStatistics.snapshot(stats, bReset);
+
+  size_t cnt = stats.size();
+  Napi::Uint32Array ids = Napi::Uint32Array::New(env, cnt);
+  Napi::Uint8Array extended = Napi::Uint8Array::New(env, cnt);
+  Napi::Float64Array count = Napi::Float64Array::New(env, cnt);
+  Napi::Float64Array rate = Napi::Float64Array::New(env, cnt);
+  Napi::Uint32Array minPeriod = Napi::Uint32Array::New(env, cnt);
+  Napi::Float64Array avgPeriod = Napi::Float64Array::New(env, cnt);
+  Napi::Uint32Array maxPeriod = Napi::Uint32Array::New(env, cnt);
+  Napi::Float64Array jitter = Napi::Float64Array::New(env, cnt);
+
+  for (size_t i = 0; i < cnt; i++) {
+    ids[i] = stats[i].id;
+    extended[i] = stats[i].bExtended ? 1 : 0;
+    count[i] = double(stats[i].count);
+    rate[i] = stats[i].rate;
+    minPeriod[i] = stats[i].minPeriodUs;
+    avgPeriod[i] = stats[i].avgPeriodUs;
+    maxPeriod[i] = stats[i].maxPeriodUs;
+    jitter[i] = stats[i].jitterUs;
+  }
+
+  Napi::Object obj = Napi::Object::New(env);
+  obj.Set("ids", ids);
+  obj.Set("extended", extended);
+  obj.Set("count", count);
+  obj.Set("rate", rate);
+  obj.Set("minPeriodUs", minPeriod);
+  obj.Set("avgPeriodUs", avgPeriod);
+  obj.Set("maxPeriodUs", maxPeriod);
+  obj.Set("jitterUs", jitter);
+  obj.Set("cntOverflow", double(cntOverflow));
+
+  return obj;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// enableBusLoad
+//
+
+Napi::Value CNodeCanal::enableBusLoad(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if ((info.Length() > 2) ||
+      ((info.Length() > 0) && !info[0].IsNumber()) ||
+      ((info.Length() > 1) && !info[1].IsString())) {
+    Napi::TypeError::New(env, "Zero to two arguments expected ([bitrate, stuffing])")
+        .ThrowAsJavaScriptException();
+    return Napi::Number::New(env, CANAL_ERROR_PARAMETER);
+  }
+
+  if (info.Length() > 1) {
+    std::string stuffing = info[1].As<Napi::String>().Utf8Value();
+    if ("computed" == stuffing) {
+      m_canalif.m_busLoad.setStuffing(BUSLOAD_STUFF_COMPUTED);
+    }
+    else if ("worst" == stuffing) {
+      m_canalif.m_busLoad.setStuffing(BUSLOAD_STUFF_WORST);
+    }
+    else if ("none" == stuffing) {
+      m_canalif.m_busLoad.setStuffing(BUSLOAD_STUFF_NONE);
+    }
+    else {
+      Napi::TypeError::New(env, "stuffing must be \"computed\", \"worst\" or \"none\"")
+          .ThrowAsJavaScriptException();
+      return Napi::Number::New(env, CANAL_ERROR_PARAMETER);
+    }
+  }
+
+  // CANAL_BAUD_* code or bits per second
+  if (info.Length() > 0) {
+    uint32_t baud = (uint32_t)info[0].As<Napi::Number>();
+    m_canalif.m_busLoad.setBitrate(CBusLoad::bitrateFromCode(baud));
+  }
+
+  m_canalif.m_bBusLoad = true;
+
+  return Napi::Number::New(env, CANAL_ERROR_SUCCESS);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// disableBusLoad
+//
+
+Napi::Value CNodeCanal::disableBusLoad(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  m_canalif.m_bBusLoad = false;
+
+  return Napi::Number::New(env, CANAL_ERROR_SUCCESS);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getBusLoad
+//
+
+Napi::Value CNodeCanal::getBusLoad(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if ((info.Length() > 1) ||
+      ((1 == info.Length()) && !info[0].IsBoolean())) {
+    Napi::TypeError::New(env, "Zero or one argument expected ([reset])")
+        .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  bool bReset = (1 == info.Length()) && info[0].As<Napi::Boolean>();
+
+  busLoad load;
+  m_canalif.m_busLoad.getLoad(&load, bReset);
+
+  Napi::Object obj = Napi::Object::New(env);
+  obj.Set("bitrate", load.bitrate);
+  obj.Set("load100ms", load.load100ms);
+  obj.Set("load1s", load.load1s);
+  obj.Set("load10s", load.load10s);
+  obj.Set("cntFrames", double(load.cntFrames));
+  obj.Set("cntBits", double(load.cntBits));
+
+  return obj;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// stopStatusWatch
+//
+
+void CNodeCanal::stopStatusWatch(void) {
+
+  if (!m_statusWatcher.isRunning()) {
+    return;
+  }
+
+  // No calls are made after stop so the callback can go
+  m_statusWatcher.stop();
+  m_statusTsfn.Release();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// watchStatus
+//
+
+Napi::Value CNodeCanal::watchStatus(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if ((info.Length() < 1) || (info.Length() > 2) || !info[0].IsFunction() ||
+      ((2 == info.Length()) && !info[1].IsNumber())) {
+    Napi::TypeError::New(env, "One or two arguments expected (callback[, periodMs])")
+        .ThrowAsJavaScriptException();
+    return Napi::Number::New(env, CANAL_ERROR_PARAMETER);
+  }
+
+  if (m_statusWatcher.isRunning()) {
+    return Napi::Number::New(env, CANAL_ERROR_INIT_READY);
+  }
+
+  uint32_t periodMs = STATUSWATCH_DEFAULT_PERIOD_MS;
+  if (2 == info.Length()) {
+    periodMs = (uint32_t)info[1].As<Napi::Number>();
+  }
+
+  Napi::ThreadSafeFunction tsfn = Napi::ThreadSafeFunction::New(
+      env,
+      info[0].As<Napi::Function>(),
+      "statusWatcher",
+      0,
+      1);
+
+  // Watching alone should not keep the process alive
+  tsfn.Unref(env);
+
+  auto callback = [](Napi::Env env,
+                      Napi::Function jsCallback,
+                      channelState *pstate) {
+    jsCallback.Call({channelStateToObject(env, pstate)});
+    delete pstate;
+  };
+
+  int rv = m_statusWatcher.start(&m_canalif, periodMs,
+                                  [tsfn, callback](const channelState *pstate) {
+    channelState *pcopy = new channelState(*pstate);
+    if (napi_ok != tsfn.NonBlockingCall(pcopy, callback)) {
+      delete pcopy;
+    }
+  });
+
+  if (CANAL_ERROR_SUCCESS != rv) {
+    tsfn.Release();
+    return Napi::Number::New(env, rv);
+  }
+
+  m_statusTsfn = tsfn;
+
+  return Napi::Number::New(env, CANAL_ERROR_SUCCESS);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// unwatchStatus
+//
+
+Napi::Value CNodeCanal::unwatchStatus(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  stopStatusWatch();
+
+  return Napi::Number::New(env, CANAL_ERROR_SUCCESS);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// stopRecoveryWatch
+//
+
+void CNodeCanal::stopRecoveryWatch(void) {
+
+  if (!m_bRecoveryWatch) {
+    return;
+  }
+
+  // Waits for a callback in progress
+  m_canalif.setRecoveryCallback(nullptr);
+  m_recoveryTsfn.Release();
+  m_bRecoveryWatch = false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// watchRecovery
+//
+
+Napi::Value CNodeCanal::watchRecovery(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if ((1 != info.Length()) || !info[0].IsFunction()) {
+    Napi::TypeError::New(env, "One argument expected (callback)")
+        .ThrowAsJavaScriptException();
+    return Napi::Number::New(env, CANAL_ERROR_PARAMETER);
+  }
+
+  stopRecoveryWatch();
+
+  Napi::ThreadSafeFunction tsfn = Napi::ThreadSafeFunction::New(
+      env,
+      info[0].As<Napi::Function>(),
+      "recoveryWatcher",
+      0,
+      1);
+
+  // Watching alone should not keep the process alive
+  tsfn.Unref(env);
+
+  auto callback = [](Napi::Env env,
+                      Napi::Function jsCallback,
+                      recoveryEvent *pev) {
+    jsCallback.Call({recoveryEventToObject(env, pev)});
+    delete pev;
+  };
+
+  m_recoveryTsfn = tsfn;
+  m_bRecoveryWatch = true;
+  m_canalif.setRecoveryCallback([tsfn, callback](const recoveryEvent *pev) {
+    recoveryEvent *pcopy = new recoveryEvent(*pev);
+    if (napi_ok != tsfn.NonBlockingCall(pcopy, callback)) {
+      delete pcopy;
+    }
+  });
+
+  return Napi::Number::New(env, CANAL_ERROR_SUCCESS);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// unwatchRecovery
+//
+
+Napi::Value CNodeCanal::unwatchRecovery(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  stopRecoveryWatch();
+
+  return Napi::Number::New(env, CANAL_ERROR_SUCCESS);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// setTxRate
+//
+
+Napi::Value CNodeCanal::setTxRate(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if ((1 != info.Length()) || !info[0].IsObject()) {
+    Napi::TypeError::New(env, "One argument expected ({framesPerSec, bitsPerSec, burstFrames, burstBits})")
+        .ThrowAsJavaScriptException();
+    return Napi::Number::New(env, CANAL_ERROR_PARAMETER);
+  }
+
+  Napi::Object obj = info[0].As<Napi::Object>();
+
+  // Members left out keep their current value
+  shaperRate rate = m_canalif.m_config.txRate;
+  static const char *keys[] = { "framesPerSec", "bitsPerSec", "burstFrames", "burstBits" };
+  uint32_t *values[] = { &rate.framesPerSec, &rate.bitsPerSec, &rate.burstFrames, &rate.burstBits };
+  for (size_t i = 0; i < 4; i++) {
+    if (!obj.Has(keys[i])) {
+      continue;
+    }
+    Napi::Value val = obj.Get(keys[i]);
+    if (!val.IsNumber() || (val.As<Napi::Number>().DoubleValue() < 0)) {
+      Napi::TypeError::New(env, std::string(keys[i]) + " must be a positive number")
+          .ThrowAsJavaScriptException();
+      return Napi::Number::New(env, CANAL_ERROR_PARAMETER);
+    }
+    *values[i] = val.As<Napi::Number>().Uint32Value();
+  }
+
+  m_canalif.setTxRate(&rate);
+
+  return Napi::Number::New(env, CANAL_ERROR_SUCCESS);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getTxStatistics
+//
+
+Napi::Value CNodeCanal::getTxStatistics(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if ((info.Length() > 1) ||
+      ((1 == info.Length()) && !info[0].IsBoolean())) {
+    Napi::TypeError::New(env, "Zero or one argument expected ([reset])")
+        .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  bool bReset = (1 == info.Length()) && info[0].As<Napi::Boolean>();
+
+  txStatistics stats;
+  m_canalif.getTxStatistics(&stats, bReset);
+
+  Napi::Object obj = Napi::Object::New(env);
+  obj.Set("cntSent", double(stats.cntSent));
+  obj.Set("cntThrottled", double(stats.cntThrottled));
+  obj.Set("throttledUs", double(stats.throttledUs));
+  obj.Set("cntRetries", double(stats.cntRetries));
+  obj.Set("cntErrors", double(stats.cntErrors));
+  obj.Set("cntExpired", double(stats.cntExpired));
+  obj.Set("queued", stats.queued);
+
+  return obj;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sendBlocking
+//
+
+Napi::Value CNodeCanal::sendBlocking(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if ((info.Length() < 1) || (info.Length() > 2) || !info[0].IsObject() ||
+      ((2 == info.Length()) && !info[1].IsNumber())) {
+    Napi::TypeError::New(env, "One or two arguments expected (frame[, timeoutMs])")
+        .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  canalMsg canmsg;
+  if (!objectToMsg(info[0].As<Napi::Object>(), &canmsg)) {
+    Napi::TypeError::New(env, "Invalid frame, data must be an array, Buffer or Uint8Array")
+        .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  // Zero would block a libuv pool thread forever
+  uint32_t timeout = 1000;
+  if (2 == info.Length()) {
+    timeout = (uint32_t)info[1].As<Napi::Number>();
+    if (0 == timeout) {
+      timeout = 1;
+    }
+  }
+
+  CSendBlockingWorker *pworker = new CSendBlockingWorker(Value(), &m_canalif, &canmsg, timeout);
+  Napi::Promise promise = pworker->Promise();
+  pworker->Queue();
+
+  return promise;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// loadDbc
+//
+
+Napi::Value CNodeCanal::loadDbc(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if ((1 != info.Length()) || !info[0].IsString()) {
+    Napi::TypeError::New(env, "One argument expected (path)")
+        .ThrowAsJavaScriptException();
+    return Napi::Number::New(env, CANAL_ERROR_PARAMETER);
+  }
+
+  std::string strError;
+  int rv = m_dbc.load(info[0].As<Napi::String>().Utf8Value(), strError);
+  if (CANAL_ERROR_SUCCESS != rv) {
+    Napi::Error err = Napi::Error::New(env, strError);
+    err.Value().Set("code", rv);
+    err.ThrowAsJavaScriptException();
+  }
+
+  return Napi::Number::New(env, rv);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// unloadDbc
+//
+
+Napi::Value CNodeCanal::unloadDbc(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  m_dbc.unload();
+
+  return Napi::Number::New(env, CANAL_ERROR_SUCCESS);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// setSignalFilter
+//
+
+Napi::Value CNodeCanal::setSignalFilter(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if ((info.Length() > 1) ||
+      ((1 == info.Length()) && !info[0].IsArray())) {
+    Napi::TypeError::New(env, "Zero or one argument expected ([names])")
+        .ThrowAsJavaScriptException();
+    return Napi::Number::New(env, CANAL_ERROR_PARAMETER);
+  }
+
+  std::vector<std::string> names;
+  if (1 == info.Length()) {
+    Napi::Array arr = info[0].As<Napi::Array>();
+    for (uint32_t i = 0; i < arr.Length(); i++) {
+      Napi::Value val = arr[i];
+      if (val.IsString()) {
+        names.push_back(val.As<Napi::String>().Utf8Value());
+      }
+    }
+  }
+
+  m_dbc.setSignalFilter(names);
+
+  return Napi::Number::New(env, CANAL_ERROR_SUCCESS);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getDbcMessages
+//
+
+Napi::Value CNodeCanal::getDbcMessages(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  std::shared_ptr<const dbcDatabase> pdb = m_dbc.getDatabase();
+  if (!pdb) {
+    return Napi::Array::New(env, 0);
+  }
+
+  Napi::Array arr = Napi::Array::New(env, pdb->messages.size());
+  for (uint32_t i = 0; i < pdb->messages.size(); i++) {
+
+    const dbcMessage &message = pdb->messages[i];
+
+    Napi::Array signals = Napi::Array::New(env, message.selected.size());
+    Napi::Array units = Napi::Array::New(env, message.selected.size());
+    for (uint32_t j = 0; j < message.selected.size(); j++) {
+      const dbcSignal &sig = message.signals[message.selected[j]];
+      signals[j] = Napi::String::New(env, sig.name);
+      units[j] = Napi::String::New(env, sig.unit);
+    }
+
+    Napi::Object obj = Napi::Object::New(env);
+    obj.Set("id", message.id);
+    obj.Set("extended", message.bExtended);
+    obj.Set("name", message.name);
+    obj.Set("dlc", message.dlc);
+    obj.Set("signals", signals);
+    obj.Set("units", units);
+    arr[i] = obj;
+  }
+
+  return arr;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// decodeFrame
+//
+
+Napi::Value CNodeCanal::decodeFrame(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if ((1 != info.Length()) || !info[0].IsObject()) {
+    Napi::TypeError::New(env, "One argument expected (frame)")
+        .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  canalMsg msg;
+  memset(&msg, 0, sizeof(canalMsg));
+  if (!objectToMsg(info[0].As<Napi::Object>(), &msg)) {
+    Napi::TypeError::New(env, "Invalid frame, data must be an array, Buffer or Uint8Array")
+        .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  std::shared_ptr<const dbcDatabase> pdb = m_dbc.getDatabase();
+  const dbcMessage *pmessage = CDbc::findMessage(pdb.get(), &msg);
+  if ((NULL == pmessage) || pmessage->selected.empty()) {
+    return env.Undefined();
+  }
+
+  Napi::Float64Array values = Napi::Float64Array::New(env, pmessage->selected.size());
+  CDbc::decode(pmessage, &msg, values.Data());
+
+  return values;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// signalsToFrame
+//
+// Build a frame from a message name or id and a { signal: value }
+// object. Throws and returns a CANAL error code on failure.
+//
+
+static int signalsToFrame(Napi::Env env,
+                            const dbcDatabase *pdb,
+                            Napi::Value message,
+                            Napi::Value signals,
+                            canalMsg *pmsg) {
+
+  if (NULL == pdb) {
+    Napi::Error err = Napi::Error::New(env, "No DBC file loaded");
+    err.Value().Set("code", CANAL_ERROR_NOT_SUPPORTED);
+    err.ThrowAsJavaScriptException();
+    return CANAL_ERROR_NOT_SUPPORTED;
+  }
+
+  if ((!message.IsString() && !message.IsNumber()) || !signals.IsObject()) {
+    Napi::TypeError::New(env, "Message name or id and a { signal: value } object expected")
+        .ThrowAsJavaScriptException();
+    return CANAL_ERROR_PARAMETER;
+  }
+
+  const dbcMessage *pmessage = message.IsString() ?
+      CDbc::findMessage(pdb, message.As<Napi::String>().Utf8Value()) :
+      CDbc::findMessage(pdb, (uint32_t)message.As<Napi::Number>());
+  if (NULL == pmessage) {
+    Napi::Error err = Napi::Error::New(env, "Unknown message " + message.ToString().Utf8Value());
+    err.Value().Set("code", CANAL_ERROR_PARAMETER);
+    err.ThrowAsJavaScriptException();
+    return CANAL_ERROR_PARAMETER;
+  }
+
+  std::vector<double> values(pmessage->signals.size(), NAN);
+
+  Napi::Object obj = signals.As<Napi::Object>();
+  Napi::Array names = obj.GetPropertyNames().As<Napi::Array>();
+  for (uint32_t i = 0; i < names.Length(); i++) {
+    std::string name = names.Get(i).ToString().Utf8Value();
+    auto it = pmessage->byName.find(name);
+    Napi::Value val = obj.Get(name);
+    if ((pmessage->byName.end() == it) || !val.IsNumber()) {
+      Napi::Error err = Napi::Error::New(env, 
+          (pmessage->byName.end() == it) ?
+            ("Unknown signal " + name + " in " + pmessage->name) :
+            ("Signal " + name + " should be a number"));
+      err.Value().Set("code", CANAL_ERROR_PARAMETER);
+      err.ThrowAsJavaScriptException();
+      return CANAL_ERROR_PARAMETER;
+    }
+    values[it->second] = val.As<Napi::Number>().DoubleValue();
+  }
+
+  std::string strError;
+  int rv = CDbc::encode(pmessage, values.data(), pmsg, strError);
+  if (CANAL_ERROR_SUCCESS != rv) {
+    Napi::Error err = Napi::Error::New(env, strError);
+    err.Value().Set("code", rv);
+    err.ThrowAsJavaScriptException();
+  }
+
+  return rv;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// encodeFrame
+//
+
+Napi::Value CNodeCanal::encodeFrame(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if (2 != info.Length()) {
+    Napi::TypeError::New(env, "Two arguments expected (message, signals)")
+        .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  canalMsg msg;
+  std::shared_ptr<const dbcDatabase> pdb = m_dbc.getDatabase();
+  if (CANAL_ERROR_SUCCESS != signalsToFrame(env, pdb.get(), info[0], info[1], &msg)) {
+    return env.Undefined();
+  }
+
+  return msgToObject(env, &msg);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sendSignals
+//
+
+Napi::Value CNodeCanal::sendSignals(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  std::shared_ptr<const dbcDatabase> pdb = m_dbc.getDatabase();
+  std::vector<canalMsg> frames;
+
+  // sendSignals(message, signals)
+  if (2 == info.Length()) {
+    frames.resize(1);
+    int rv = signalsToFrame(env, pdb.get(), info[0], info[1], &frames[0]);
+    if (CANAL_ERROR_SUCCESS != rv) {
+      return Napi::Number::New(env, rv);
+    }
+  }
+  // sendSignals([{ message, signals }, ...])
+  else if ((1 == info.Length()) && info[0].IsArray()) {
+    Napi::Array arr = info[0].As<Napi::Array>();
+    frames.resize(arr.Length());
+    for (uint32_t i = 0; i < arr.Length(); i++) {
+      Napi::Value item = arr[i];
+      if (!item.IsObject()) {
+        Napi::TypeError::New(env, "Array of { message, signals } expected")
+            .ThrowAsJavaScriptException();
+        return Napi::Number::New(env, CANAL_ERROR_PARAMETER);
+      }
+      Napi::Object obj = item.As<Napi::Object>();
+      int rv = signalsToFrame(env, pdb.get(), obj.Get("message"), obj.Get("signals"), &frames[i]);
+      if (CANAL_ERROR_SUCCESS != rv) {
+        return Napi::Number::New(env, rv);
+      }
+    }
+  }
+  else {
+    Napi::TypeError::New(env, "Two arguments (message, signals) or an array of { message, signals } expected")
+        .ThrowAsJavaScriptException();
+    return Napi::Number::New(env, CANAL_ERROR_PARAMETER);
+  }
+
+  // All frames are built before any is sent
+  for (size_t i = 0; i < frames.size(); i++) {
+    int rv = m_canalif.CanalSend(&frames[i]);
+    if (CANAL_ERROR_SUCCESS != rv) {
+      if (1 == info.Length()) {
+        // Tell which frames already went out
+        Napi::Error err = Napi::Error::New(env, "Failed to send frame " + std::to_string(i) + " of the batch");
+        err.Value().Set("code", rv);
+        err.Value().Set("index", double(i));
+        err.Value().Set("cntSent", double(i));
+        err.ThrowAsJavaScriptException();
+      }
+      return Napi::Number::New(env, rv);
+    }
+  }
+
+  return Napi::Number::New(env, CANAL_ERROR_SUCCESS);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// msgToObject
+//
+// Build the JS object delivered for a received CAN message
+//
+
+Napi::Object msgToObject(Napi::Env env, const canalMsg *pmsg) {
+
+  Napi::Array dataArray = Napi::Array::New(env, pmsg->sizeData);
+  for (uint32_t i = 0; i < pmsg->sizeData; i++) {
+    dataArray[uint32_t(i)] =
+        Napi::Number::New(env, pmsg->data[i]);
+  }
+
+  Napi::Object obj = Napi::Object::New(env);
+  obj.Set("id", uint32_t(pmsg->id));
+  obj.Set("flags", uint32_t(pmsg->flags));
+  obj.Set("obid", uint32_t(pmsg->obid));
+  obj.Set("timestamp", uint32_t(pmsg->timestamp));
+  obj.Set("data", dataArray );
+
+  return obj;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// framesToColumns
+//
+// Transpose frames to one typed array per member. All columns are
+// views of one buffer, 8 byte columns first so every view is aligned.
+//
+
+Napi::Object framesToColumns(Napi::Env env, const canalMsg *pmsgs, size_t cnt) {
+
+  Napi::ArrayBuffer buf = Napi::ArrayBuffer::New(env, cnt * (8 + 8 + 4 + 4 + 1));
+  uint8_t *p = (uint8_t *)buf.Data();
+
+  double *ptimestamps = (double *)p;
+  uint8_t *pdata = p + 8 * cnt;
+  uint32_t *pids = (uint32_t *)(p + 16 * cnt);
+  uint32_t *pflags = (uint32_t *)(p + 20 * cnt);
+  uint8_t *pdlc = p + 24 * cnt;
+
+  for (size_t i = 0; i < cnt; i++) {
+    uint8_t size = (pmsgs[i].sizeData > 8) ? 8 : pmsgs[i].sizeData;
+    ptimestamps[i] = pmsgs[i].timestamp;
+    pids[i] = pmsgs[i].id;
+    pflags[i] = pmsgs[i].flags;
+    pdlc[i] = size;
+    memcpy(pdata + 8 * i, pmsgs[i].data, size);
+    memset(pdata + 8 * i + size, 0, 8 - size);
+  }
+
+  Napi::Object obj = Napi::Object::New(env);
+  obj.Set("count", double(cnt));
+  obj.Set("timestamps", Napi::Float64Array::New(env, cnt, buf, 0));
+  obj.Set("data", Napi::Uint8Array::New(env, 8 * cnt, buf, 8 * cnt));
+  obj.Set("ids", Napi::Uint32Array::New(env, cnt, buf, 16 * cnt));
+  obj.Set("flags", Napi::Uint32Array::New(env, cnt, buf, 20 * cnt));
+  obj.Set("dlc", Napi::Uint8Array::New(env, cnt, buf, 24 * cnt));
+
+  return obj;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// statusToObject
+//
+// Build the JS object for a CANAL status structure
+//
+
+Napi::Object statusToObject(Napi::Env env, const canalStatus *pstatus) {
+
+  Napi::Object obj = Napi::Object::New(env);
+  obj.Set("Channel_Status", uint32_t(pstatus->channel_status));
+  obj.Set("LastErrorCode", uint32_t(pstatus->lasterrorcode));
+  obj.Set("LastErrorSubCode", uint32_t(pstatus->lasterrorsubcode));
+  obj.Set("LastErrorStr", pstatus->lasterrorstr);
+
+  return obj;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// statisticsToObject
+//
+// Build the JS object for a CANAL statistics structure
+//
+
+Napi::Object statisticsToObject(Napi::Env env, const canalStatistics *pstat) {
+
+  Napi::Object obj = Napi::Object::New(env);
+  obj.Set("cntReceiveFrames", uint32_t(pstat->cntReceiveFrames));
+  obj.Set("cntTransmitFrames", uint32_t(pstat->cntTransmitFrames));
+  obj.Set("cntReceiveData", uint32_t(pstat->cntReceiveData));
+  obj.Set("cntTransmitData", uint32_t(pstat->cntTransmitData));
+  obj.Set("cntOverruns", uint32_t(pstat->cntOverruns));
+  obj.Set("cntBusWarnings", uint32_t(pstat->cntBusWarnings));
+  obj.Set("cntBusOff", uint32_t(pstat->cntBusOff));
+
+  return obj;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// channelStateToObject
+//
+// Build the JS object for a state found by the status watcher
+//
+
+Napi::Object channelStateToObject(Napi::Env env, const channelState *pstate) {
+
+  Napi::Object obj = Napi::Object::New(env);
+  obj.Set("state", CStatusWatcher::stateName(pstate->state));
+  obj.Set("rv", pstate->rv);
+  obj.Set("txErrors", pstate->txErrors);
+  obj.Set("rxErrors", pstate->rxErrors);
+
+  if (CANAL_ERROR_SUCCESS == pstate->rv) {
+    obj.Set("status", statusToObject(env, &pstate->status));
+  }
+
+  if (pstate->bStatistics) {
+    obj.Set("statistics", statisticsToObject(env, &pstate->statistics));
+  }
+
+  return obj;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// recoveryEventToObject
+//
+// Build the JS object for a driver recovery event
+//
+
+Napi::Object recoveryEventToObject(Napi::Env env, const recoveryEvent *pev) {
+
+  const char *state;
+  switch (pev->state) {
+    case RECOVER_STATE_LOST:
+      state = "lost";
+      break;
+    case RECOVER_STATE_REOPENING:
+      state = "reopening";
+      break;
+    case RECOVER_STATE_FAILED:
+      state = "failed";
+      break;
+    case RECOVER_STATE_RECOVERED:
+      state = "recovered";
+      break;
+    default:
+      state = "ok";
+      break;
+  }
+
+  Napi::Object obj = Napi::Object::New(env);
+  obj.Set("state", state);
+  obj.Set("rv", pev->rv);
+  obj.Set("attempt", pev->attempt);
+  obj.Set("backoffMs", pev->backoffMs);
+  obj.Set("cntRecoveries", pev->cntRecoveries);
+  obj.Set("cntTxExpired", double(pev->cntTxExpired));
+
+  return obj;
+}
+
+// The thread-safe function finalizer callback. This callback executes
+// at destruction of thread-safe function, taking as arguments the finalizer
+// data and threadsafe-function context.
+void finalizerCallback( Napi::Env env, 
+                          void *finalizeData,
+                          tsfnContext *context ) {
+  // Join the thread
+  context->workThread.join();
+
+  // Resolve the Promise previously returned to JS via the CreateTSFN method.
+  context->deferred.Resolve(Napi::Boolean::New(env, true));
+  delete context;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// addListener
+//
+
+bool CNodeCanal::addListener(Napi::Env &env,
+                                    Napi::Function &callback) 
+{
+  napi_value work_name;
+
+  // This string describes the asynchronous work.
+  napi_create_string_utf8( env, 
+                            "addListner",
+                            NAPI_AUTO_LENGTH, 
+                            &work_name);
+
+  // Construct context data
+  auto context = new tsfnContext(env); 
   context->m_pif = &m_canalif;                   
+  context->m_pj1939 = &m_j1939;
+  context->m_pvscp = &m_vscp;
+  context->m_pmatcher = &m_matcher;
+  context->m_pbRunning = &m_bListenerRunning;
+  context->m_pcoalesce = &m_coalesce;
+  context->m_pdbc = &m_dbc;
+  context->m_pbColumnar = &m_bColumnar;
 
   // Create a ThreadSafeFunction
   context->tsfn = Napi::ThreadSafeFunction::New(
@@ -611,6 +3052,9 @@ bool CNodeCanal::addListener(Napi::Env &env,
       (void *)nullptr 
     );
   
+  m_bListening = true;
+  m_bListenerRunning = true;
+
   // Create a native thread
 
   void *data = (void *)context;
@@ -618,12 +3062,140 @@ bool CNodeCanal::addListener(Napi::Env &env,
 
     tsfnContext *ctx = (tsfnContext *)data;
 
+    // Frames are delivered in batches, one call per frame
     auto callback = [](Napi::Env env, 
                         Napi::Function jsCallback,
-                        canalMsg *pmsg) {
+                        std::vector<canalMsg> *pbatch) {
+
+      for (const canalMsg &msg : *pbatch) {
+        Napi::Object obj = msgToObject(env, &msg);
+        jsCallback.Call({obj});
+      }
+
+      // We're finished with the data.
+      delete pbatch;
+    };
+
+    // Frames with signals decoded from a DBC file get the
+    // message name and a view of the signal values
+    auto decodedCallback = [](Napi::Env env, 
+                                Napi::Function jsCallback,
+                                decodedBatch *pdecoded) {
+
+      const dbcDecoded &decoded = pdecoded->m_decoded;
+
+      // One buffer for all values of the batch
+      Napi::ArrayBuffer buf = 
+          Napi::ArrayBuffer::New(env, decoded.values.size() * sizeof(double));
+      if (decoded.values.size()) {
+        memcpy(buf.Data(), 
+                decoded.values.data(), 
+                decoded.values.size() * sizeof(double));
+      }
+
+      for (size_t i = 0; i < pdecoded->m_pbatch->size(); i++) {
+        Napi::Object obj = msgToObject(env, &(*pdecoded->m_pbatch)[i]);
+        if (decoded.message[i] >= 0) {
+          obj.Set("message", decoded.pdb->messages[decoded.message[i]].name);
+          obj.Set("signals", 
+                  Napi::Float64Array::New(env, 
+                                decoded.offset[i + 1] - decoded.offset[i],
+                                buf,
+                                decoded.offset[i] * sizeof(double)));
+        }
+        jsCallback.Call({obj});
+      }
+
+      // We're finished with the data.
+      delete pdecoded->m_pbatch;
+      delete pdecoded;
+    };
+
+    // The whole batch as columns in one call. Decoded signals of
+    // frame n are signals[signalOffsets[n]..signalOffsets[n+1]]
+    auto columnarCallback = [](Napi::Env env, 
+                                Napi::Function jsCallback,
+                                decodedBatch *pdecoded) {
+
+      const dbcDecoded &decoded = pdecoded->m_decoded;
+
+      Napi::Object obj = framesToColumns(env, 
+                                          pdecoded->m_pbatch->data(), 
+                                          pdecoded->m_pbatch->size());
+      if (decoded.pdb) {
+        Napi::Float64Array signals = 
+            Napi::Float64Array::New(env, decoded.values.size());
+        Napi::Uint32Array offsets = 
+            Napi::Uint32Array::New(env, decoded.offset.size());
+        if (decoded.values.size()) {
+          memcpy(signals.Data(), 
+                  decoded.values.data(), 
+                  decoded.values.size() * sizeof(double));
+        }
+        memcpy(offsets.Data(), 
+                decoded.offset.data(), 
+                decoded.offset.size() * sizeof(uint32_t));
+        obj.Set("signals", signals);
+        obj.Set("signalOffsets", offsets);
+      }
+      jsCallback.Call({obj});
+
+      // We're finished with the data.
+      delete pdecoded->m_pbatch;
+      delete pdecoded;
+    };
+
+    // Hand the coalesced frames to JS
+    auto flush = [ctx, callback, decodedCallback, columnarCallback] {
+      std::vector<canalMsg> *pbatch = ctx->m_pcoalesce->take();
+      if (NULL == pbatch) {
+        return;
+      }
+
+      // Decode signals here rather than in the JS thread
+      if (ctx->m_pdbc->isLoaded() || *ctx->m_pbColumnar) {
+        decodedBatch *pdecoded = new decodedBatch;
+        pdecoded->m_pbatch = pbatch;
+        if (ctx->m_pdbc->isLoaded()) {
+          ctx->m_pdbc->decode(pbatch->data(), pbatch->size(), &pdecoded->m_decoded);
+        }
+        napi_status status = *ctx->m_pbColumnar ?
+            ctx->tsfn.BlockingCall(pdecoded, columnarCallback) :
+            ctx->tsfn.BlockingCall(pdecoded, decodedCallback);
+        if (napi_ok != status) {
+          delete pbatch;
+          delete pdecoded;
+        }
+        return;
+      }
+
+      if (napi_ok != ctx->tsfn.BlockingCall(pbatch, callback)) {
+        delete pbatch;
+      }
+    };
+
+    auto vscpCallback = [](Napi::Env env, 
+                            Napi::Function jsCallback,
+                            vscpLevel1Msg *pvscpmsg) {
 
-      Napi::Array dataArray = Napi::Array::New(env, pmsg->sizeData);
-      for (uint32_t i = 0; i < pmsg->sizeData; i++) {
+      Napi::Object obj = msgToObject(env, &pvscpmsg->msg);
+      obj.Set("priority", uint32_t(pvscpmsg->priority));
+      obj.Set("hardcoded", pvscpmsg->bHardcoded);
+      obj.Set("vscpClass", uint32_t(pvscpmsg->vscpClass));
+      obj.Set("vscpType", uint32_t(pvscpmsg->vscpType));
+      obj.Set("nickname", uint32_t(pvscpmsg->nickname));
+      jsCallback.Call({obj});
+
+      // We're finished with the data.
+      delete pvscpmsg;
+    };
+
+    auto j1939Callback = [](Napi::Env env, 
+                              Napi::Function jsCallback,
+                              j1939Msg *pmsg) {
+
+      Napi::Array dataArray = Napi::Array::New(env, pmsg->data.size());
+      for (uint32_t i = 0; i < pmsg->data.size(); i++) {
         dataArray[uint32_t(i)] =
             Napi::Number::New(env, pmsg->data[i]);
       }
@@ -633,6 +3205,10 @@ bool CNodeCanal::addListener(Napi::Env &env,
       obj.Set("flags", uint32_t(pmsg->flags));
       obj.Set("obid", uint32_t(pmsg->obid));
       obj.Set("timestamp", uint32_t(pmsg->timestamp));
+      obj.Set("pgn", uint32_t(pmsg->pgn));
+      obj.Set("priority", uint32_t(pmsg->priority));
+      obj.Set("src", uint32_t(pmsg->src));
+      obj.Set("dst", uint32_t(pmsg->dst));
       obj.Set("data", dataArray );
       jsCallback.Call({obj});
 
@@ -640,31 +3216,141 @@ bool CNodeCanal::addListener(Napi::Env &env,
       delete pmsg;
     };
 
+    auto waitCallback = [](Napi::Env env, 
+                            Napi::Function jsCallback,
+                            waitContext *pwait) {
+
+      if (CANAL_ERROR_SUCCESS == pwait->rv) {
+        pwait->deferred.Resolve(msgToObject(env, &pwait->msg));
+      }
+      else {
+        Napi::Error err = Napi::Error::New(env, 
+                            (CANAL_ERROR_TIMEOUT == pwait->rv) ? 
+                              "Timeout waiting for response" :
+                              "Interface closed while waiting for response");
+        err.Value().Set("code", pwait->rv);
+        pwait->deferred.Reject(err.Value());
+      }
+
+      // We're finished with the data.
+      delete pwait;
+    };
+
     canalMsg msg;
+    j1939Msg j1939msg;
+    vscpLevel1Msg vscpmsg;
+    std::vector<void *> expired;
+
+    rtApplyTuning(&ctx->m_pif->m_tuning);
+
     while (!ctx->m_pif->m_bQuit) {
 
+      // Reject sendAndWait requests that have timed out. Also while
+      // not connected so they do not wait for a reopen.
+      expired.clear();
+      ctx->m_pmatcher->expire(expired);
+      for (void *p : expired) {
+        waitContext *pwait = (waitContext *)p;
+        pwait->rv = CANAL_ERROR_TIMEOUT;
+        if (napi_ok != ctx->tsfn.BlockingCall(pwait, waitCallback)) {
+          delete pwait;
+        }
+      }
+
+      // Deliver frames that have been held long enough
+      if (ctx->m_pcoalesce->isDue()) {
+        flush();
+      }
+
       // Sit and wait for connection if were not connected
       if ( 0 == ctx->m_pif->m_openHandle ) {
         std::this_thread::sleep_for(std::chrono::microseconds(500));
         continue;
       }
 
+      // Wake up in time for the first sendAndWait timeout and
+      // for the held frames
+      uint32_t timeout = ctx->m_pmatcher->nextTimeout(ctx->m_pif->m_config.receiveTimeout);
+      timeout = ctx->m_pcoalesce->nextTimeout(timeout);
+
       if ( ctx->m_pif->m_openHandle && 
-            (CANAL_ERROR_SUCCESS ==
-          ctx->m_pif->m_proc_CanalBlockingReceive(ctx->m_pif->m_openHandle, 
-                                                    &msg, 
-                                                    500))) {
-        canalMsg *pmsg = new canalMsg();
-        memcpy(pmsg, &msg, sizeof(canalMsg));
-        napi_status status = ctx->tsfn.BlockingCall(pmsg, callback);
-        if (status != napi_ok) {
-          // Handle error
-          delete pmsg;
+            (CANAL_ERROR_SUCCESS == ctx->m_pif->receive(&msg, timeout))) {
+
+        // Responses to sendAndWait requests go to their promise only
+        waitContext *pwait = (waitContext *)ctx->m_pmatcher->match(&msg);
+        if (NULL != pwait) {
+          memcpy(&pwait->msg, &msg, sizeof(canalMsg));
+          pwait->rv = CANAL_ERROR_SUCCESS;
+          if (napi_ok != ctx->tsfn.BlockingCall(pwait, waitCallback)) {
+            delete pwait;
+          }
+          continue;
+        }
+
+        // J1939 frames are decoded and multi-packet transfers
+        // reassembled before anything is handed to JS
+        if (ctx->m_pj1939->isEnabled()) {
+          int j1939rv = ctx->m_pj1939->process(&msg, &j1939msg);
+          if (J1939_RESULT_CONSUMED == j1939rv) {
+            continue;
+          }
+          else if (J1939_RESULT_MESSAGE == j1939rv) {
+            flush();  // Keep order
+            j1939Msg *pj1939msg = new j1939Msg(std::move(j1939msg));
+            napi_status status = ctx->tsfn.BlockingCall(pj1939msg, j1939Callback);
+            if (status != napi_ok) {
+              delete pj1939msg;
+            }
+            continue;
+          }
+        }
+
+        // VSCP Level I header is decoded and filtered before
+        // anything is handed to JS
+        if (ctx->m_pvscp->isEnabled() && 
+            (msg.flags & CANAL_IDFLAG_EXTENDED) &&
+            !(msg.flags & CANAL_IDFLAG_STATUS)) {
+          CVscpLevel1::decode(&msg, &vscpmsg);
+          if (!ctx->m_pvscp->isWanted(&vscpmsg)) {
+            continue;
+          }
+          flush();  // Keep order
+          vscpLevel1Msg *pvscpmsg = new vscpLevel1Msg(vscpmsg);
+          napi_status status = ctx->tsfn.BlockingCall(pvscpmsg, vscpCallback);
+          if (status != napi_ok) {
+            delete pvscpmsg;
+          }
+          continue;
+        }
+
+        // Held until the batch is full or old enough
+        if (ctx->m_pcoalesce->add(&msg)) {
+          flush();
         }
-        
+      }
+      else if (ctx->m_pj1939->isEnabled()) {
+        // Time out stale transfers also on a silent bus
+        ctx->m_pj1939->expire();
       }
     }
 
+    // Frames still held
+    flush();
+
+    // Requests still waiting will never get a response
+    expired.clear();
+    ctx->m_pmatcher->clear(expired);
+    for (void *p : expired) {
+      waitContext *pwait = (waitContext *)p;
+      pwait->rv = CANAL_ERROR_NOT_OPEN;
+      if (napi_ok != ctx->tsfn.BlockingCall(pwait, waitCallback)) {
+        delete pwait;
+      }
+    }
+
+    // The CNodeCanal object may be gone after this
+    ctx->m_pbRunning->store(false);
+
     ctx->tsfn.Release();
 
   });
@@ -30,10 +30,33 @@
 //
 
 #include <pthread.h>
+#include "broadcast.h"
 #include "canalif.h"
+#include "coalesce.h"
+#include "cyclic.h"
+#include "dbc.h"
+#include "framestream.h"
+#include "j1939.h"
+#include "reqmatch.h"
+#include "statuswatch.h"
+#include "vscpl1.h"
 #include <napi.h>
 
+#include <atomic>
+#include <memory>
+#include <string>
 #include <thread>
+#include <vector>
+
+// Frame record written by receiveInto. Members are in host byte
+// order, little endian on the platforms supported.
+#define RECORD_SIZE                 32      // Bytes per frame
+#define RECORD_OFFSET_ID            0       // uint32
+#define RECORD_OFFSET_FLAGS         4       // uint32
+#define RECORD_OFFSET_OBID          8       // uint32
+#define RECORD_OFFSET_TIMESTAMP     12      // uint32
+#define RECORD_OFFSET_DATA          16      // 8 bytes, zero padded
+#define RECORD_OFFSET_SIZE          24      // uint8, rest is reserved
 
 struct tsfnContext {
 
@@ -47,23 +70,125 @@ struct tsfnContext {
   // CANAL interface
   CCanalIf *m_pif;
 
+  // J1939 decoder/reassembler
+  CJ1939 *m_pj1939;
+
+  // VSCP Level I decoder/filter
+  CVscpLevel1 *m_pvscp;
+
+  // sendAndWait response matcher
+  CRequestMatcher *m_pmatcher;
+
+  // Coalescing of delivered frames
+  CCoalescer *m_pcoalesce;
+
+  // DBC signal decoding
+  CDbc *m_pdbc;
+
+  // True to deliver batches as columns
+  std::atomic<bool> *m_pbColumnar;
+
+  // Cleared when the thread no longer use the CNodeCanal object
+  std::atomic<bool> *m_pbRunning;
+
+  // Native thread
+  std::thread workThread;
+
+  Napi::ThreadSafeFunction tsfn;
+};
+
+// A JS callback reading from a broadcast ring
+struct readerContext {
+
+  // Ring read from. Shared, the owner may be in another thread.
+  std::shared_ptr<CBroadcastRing> m_pring;
+
+  // Reader id in ring
+  uint32_t m_id;
+
+  // Max frames handed to JS per call
+  uint32_t m_batchSize;
+
   // Native thread
   std::thread workThread;
 
   Napi::ThreadSafeFunction tsfn;
 };
 
+// Build JS objects from CANAL structures
+Napi::Object msgToObject(Napi::Env env, const canalMsg *pmsg);
+Napi::Object framesToColumns(Napi::Env env, const canalMsg *pmsgs, size_t cnt);
+Napi::Object statusToObject(Napi::Env env, const canalStatus *pstatus);
+Napi::Object statisticsToObject(Napi::Env env, const canalStatistics *pstat);
+Napi::Object channelStateToObject(Napi::Env env, const channelState *pstate);
+Napi::Object recoveryEventToObject(Napi::Env env, const recoveryEvent *pev);
+
+// An outstanding sendAndWait request
+struct waitContext {
+
+  waitContext(Napi::Env env) : deferred(Napi::Promise::Deferred::New(env)) {
+    rv = CANAL_ERROR_SUCCESS;
+  };
+
+  // Native Promise returned to JavaScript
+  Napi::Promise::Deferred deferred;
+
+  // Response
+  canalMsg msg;
+
+  // CANAL_ERROR_SUCCESS or reason for rejection
+  int rv;
+};
+
+// A batch of frames with their decoded signals
+struct decodedBatch {
+
+  // Frames
+  std::vector<canalMsg> *m_pbatch;
+
+  // Signals of the frames
+  dbcDecoded m_decoded;
+};
+
+// Property names of frame objects. Looked up for every frame sent
+// so they are created once and not from a C string each time.
+struct msgKeys {
+  Napi::Reference<Napi::String> flags;
+  Napi::Reference<Napi::String> ext;
+  Napi::Reference<Napi::String> rtr;
+  Napi::Reference<Napi::String> timestamp;
+  Napi::Reference<Napi::String> obid;
+  Napi::Reference<Napi::String> id;
+  Napi::Reference<Napi::String> data;
+  Napi::Reference<Napi::String> sizeData;
+  Napi::Reference<Napi::String> priority;
+};
+
+// Addon state. One per environment (main thread and each worker
+// thread) so the addon can be loaded in several worker_threads.
+struct addonData {
+
+  // Class definition exported to JS
+  Napi::FunctionReference constructor;
+
+  // Property names of frame objects
+  msgKeys keys;
+};
+
 class CNodeCanal : public Napi::ObjectWrap<CNodeCanal> {
 public:
   static Napi::Object
   Init(Napi::Env env,
        Napi::Object exports); // Init function for setting the export key to JS
   CNodeCanal(const Napi::CallbackInfo &info); // Constructor to initialise
+  ~CNodeCanal();
 
 private:
-  static Napi::FunctionReference
-      constructor; // reference to store the class definition that needs to be
-                   // exported to JS
+  // Stop native threads and close the channel. Never calls JS.
+  void shutdown(void);
+
+  // Environment cleanup hook, stops native threads of an instance
+  static void cleanupHook(void *arg);
 
   // Wrapper for init
   Napi::Value init(const Napi::CallbackInfo &info); 
@@ -113,13 +238,234 @@ private:
   // Wrapper for CanalGetDriverInfo
   Napi::Value getDriverInfo(const Napi::CallbackInfo &info);
 
+  // Enable J1939 decoding/reassembly in listener
+  Napi::Value enableJ1939(const Napi::CallbackInfo &info);
+
+  // Disable J1939 decoding/reassembly in listener
+  Napi::Value disableJ1939(const Napi::CallbackInfo &info);
+
+  // Get J1939 transport statistics
+  Napi::Value getJ1939Statistics(const Napi::CallbackInfo &info);
+
+  // Enable VSCP Level I decoding/filtering in listener
+  Napi::Value enableVscp(const Napi::CallbackInfo &info);
+
+  // Disable VSCP Level I decoding/filtering in listener
+  Napi::Value disableVscp(const Napi::CallbackInfo &info);
+
+  // Add a periodic transmit job
+  Napi::Value addCyclic(const Napi::CallbackInfo &info);
+
+  // Update frame/period of a periodic transmit job
+  Napi::Value updateCyclic(const Napi::CallbackInfo &info);
+
+  // Remove a periodic transmit job
+  Napi::Value removeCyclic(const Napi::CallbackInfo &info);
+
+  // Get send/jitter statistics for a periodic transmit job
+  Napi::Value getCyclicStatistics(const Napi::CallbackInfo &info);
+
+  // Send a request and wait for the matching response
+  Napi::Value sendAndWait(const Napi::CallbackInfo &info);
+
+  // Promise based CanalOpen
+  Napi::Value openAsync(const Napi::CallbackInfo &info);
+
+  // Promise based CanalClose
+  Napi::Value closeAsync(const Napi::CallbackInfo &info);
+
+  // Promise based CanalGetStatus
+  Napi::Value getStatusAsync(const Napi::CallbackInfo &info);
+
+  // Promise based CanalGetStatistics
+  Napi::Value getStatisticsAsync(const Napi::CallbackInfo &info);
+
+  // Promise based CanalSetBaudrate
+  Napi::Value setBaudrateAsync(const Napi::CallbackInfo &info);
+
+  // Promise based CanalBlockingReceive
+  Napi::Value receiveAsync(const Napi::CallbackInfo &info);
+
+  // Start pull based frame stream
+  Napi::Value startStream(const Napi::CallbackInfo &info);
+
+  // Read a batch of frames from the frame stream
+  Napi::Value readBatch(const Napi::CallbackInfo &info);
+
+  // Stop the frame stream
+  Napi::Value stopStream(const Napi::CallbackInfo &info);
+
+  // Start broadcasting received frames to many readers
+  Napi::Value enableBroadcast(const Napi::CallbackInfo &info);
+
+  // Stop broadcasting
+  Napi::Value disableBroadcast(const Napi::CallbackInfo &info);
+
+  // Attach to a broadcast published by another instance
+  Napi::Value attachBroadcast(const Napi::CallbackInfo &info);
+
+  // Add a broadcast reader callback
+  Napi::Value addReader(const Napi::CallbackInfo &info);
+
+  // Remove a broadcast reader
+  Napi::Value removeReader(const Napi::CallbackInfo &info);
+
+  // Get read/drop statistics for a broadcast reader
+  Napi::Value getReaderStatistics(const Napi::CallbackInfo &info);
+
+  // Set time the receive threads spin before blocking
+  Napi::Value setReceiveSpin(const Napi::CallbackInfo &info);
+
+  // Get spin/latency statistics for the receive threads
+  Napi::Value getReceiveStatistics(const Napi::CallbackInfo &info);
+
+  // Set how received frames are coalesced before delivery
+  Napi::Value setDeliveryPolicy(const Napi::CallbackInfo &info);
+
+  // Get achieved batch sizes and hold times
+  Napi::Value getDeliveryStatistics(const Napi::CallbackInfo &info);
+
+  // Set if the listener delivers frame objects or column batches
+  Napi::Value setDeliveryFormat(const Napi::CallbackInfo &info);
+
+  // Read a batch of frames from the frame stream as columns
+  Napi::Value readColumns(const Napi::CallbackInfo &info);
+
+  // Start keeping per id statistics in the receive threads
+  Napi::Value enableIdStatistics(const Napi::CallbackInfo &info);
+
+  // Stop keeping per id statistics
+  Napi::Value disableIdStatistics(const Napi::CallbackInfo &info);
+
+  // Get per id statistics as typed arrays
+  Napi::Value getIdStatistics(const Napi::CallbackInfo &info);
+
+  // Start estimating bus load
+  Napi::Value enableBusLoad(const Napi::CallbackInfo &info);
+
+  // Stop estimating bus load
+  Napi::Value disableBusLoad(const Napi::CallbackInfo &info);
+
+  // Get bus load over the windows
+  Napi::Value getBusLoad(const Napi::CallbackInfo &info);
+
+  // Start watching channel state
+  Napi::Value watchStatus(const Napi::CallbackInfo &info);
+
+  // Stop watching channel state
+  Napi::Value unwatchStatus(const Napi::CallbackInfo &info);
+
+  // Set callback for driver recovery events
+  Napi::Value watchRecovery(const Napi::CallbackInfo &info);
+
+  // Remove the driver recovery callback
+  Napi::Value unwatchRecovery(const Napi::CallbackInfo &info);
+
+  // Set rate limits for async sends
+  Napi::Value setTxRate(const Napi::CallbackInfo &info);
+
+  // Get async send statistics
+  Napi::Value getTxStatistics(const Napi::CallbackInfo &info);
+
+  // Blocking send in a worker thread
+  Napi::Value sendBlocking(const Napi::CallbackInfo &info);
+
+  // Send a frame from positional arguments
+  Napi::Value sendRaw(const Napi::CallbackInfo &info);
+
+  // Receive frames into a preallocated buffer
+  Napi::Value receiveInto(const Napi::CallbackInfo &info);
+
+  // Receive waiting frames as one batch
+  Napi::Value receiveMany(const Napi::CallbackInfo &info);
+
+  // Load a DBC file for signal decoding
+  Napi::Value loadDbc(const Napi::CallbackInfo &info);
+
+  // Drop the DBC file
+  Napi::Value unloadDbc(const Napi::CallbackInfo &info);
+
+  // Select signals to decode
+  Napi::Value setSignalFilter(const Napi::CallbackInfo &info);
+
+  // Get messages and decoded signals of the DBC file
+  Napi::Value getDbcMessages(const Napi::CallbackInfo &info);
+
+  // Decode the signals of a frame
+  Napi::Value decodeFrame(const Napi::CallbackInfo &info);
+
+  // Build a frame from signal values
+  Napi::Value encodeFrame(const Napi::CallbackInfo &info);
+
+  // Build frames from signal values and send them
+  Napi::Value sendSignals(const Napi::CallbackInfo &info);
+
   // Message listener adder
   bool addListener(Napi::Env &env, Napi::Function &callback);
 
+  // Stop the status watcher and release its callback
+  void stopStatusWatch(void);
+
+  // Remove the recovery callback and release it
+  void stopRecoveryWatch(void);
+
+  // Remove readers and stop the broadcast ring if owned
+  void stopBroadcast(void);
+
   // Callback defined if non-polling
   Napi::Function m_callback;
 
+  // True when the listener thread has been started
+  bool m_bListening;
+
+  // True while the listener thread use this object
+  std::atomic<bool> m_bListenerRunning;
+
+  // True if the listener delivers column batches
+  std::atomic<bool> m_bColumnar;
+
   // The main functionality
   CCanalIf m_canalif;   // internal instance of CCanalIf used to perform actual
                         // operations.                        
+
+  // J1939 decoding/reassembly for the listener
+  CJ1939 m_j1939;
+
+  // VSCP Level I decoding/filtering for the listener
+  CVscpLevel1 m_vscp;
+
+  // Periodic transmit scheduler
+  CCyclicScheduler m_cyclic;
+
+  // Outstanding sendAndWait requests
+  CRequestMatcher m_matcher;
+
+  // Coalescing of frames delivered by the listener
+  CCoalescer m_coalesce;
+
+  // Pull based frame stream
+  CFrameStream m_stream;
+
+  // DBC signal decoding for the listener
+  CDbc m_dbc;
+
+  // Channel state watcher and its JS callback
+  CStatusWatcher m_statusWatcher;
+  Napi::ThreadSafeFunction m_statusTsfn;
+
+  // JS callback for driver recovery events
+  bool m_bRecoveryWatch;
+  Napi::ThreadSafeFunction m_recoveryTsfn;
+
+  // Broadcast ring, owned or attached to
+  std::shared_ptr<CBroadcastRing> m_pbroadcast;
+
+  // True if this instance writes to m_pbroadcast
+  bool m_bBroadcastOwner;
+
+  // Name m_pbroadcast is published under, empty if none
+  std::string m_broadcastName;
+
+  // Readers added by this instance
+  std::vector<uint32_t> m_readers;
 };
\ No newline at end of file
@@ -0,0 +1,215 @@
+///////////////////////////////////////////////////////////////////////////
+// reqmatch.cpp
+//
+// Request/response correlation. Outstanding requests are matched
+// against received frames in the receive thread.
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "reqmatch.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// constructor
+//
+
+CRequestMatcher::CRequestMatcher()
+{
+    m_cntPending = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// deconstructor
+//
+
+CRequestMatcher::~CRequestMatcher()
+{
+    ;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// add
+//
+
+void
+CRequestMatcher::add(const requestMatch *pmatch, uint32_t timeout, void *puser)
+{
+    pendingRequest req;
+
+    req.match    = *pmatch;
+    req.deadline = clock::now() + std::chrono::milliseconds(timeout);
+    req.puser    = puser;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_requests.push_back(req);
+    m_cntPending = m_requests.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// remove
+//
+
+bool
+CRequestMatcher::remove(void *puser)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (auto it = m_requests.begin(); it != m_requests.end(); ++it) {
+        if (it->puser == puser) {
+            m_requests.erase(it);
+            m_cntPending = m_requests.size();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// match
+//
+
+void *
+CRequestMatcher::match(const canalMsg *pmsg)
+{
+    if (!m_cntPending) {
+        return NULL;
+    }
+
+    // Not a response from a node
+    if (pmsg->flags & CANAL_IDFLAG_STATUS) {
+        return NULL;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (auto it = m_requests.begin(); it != m_requests.end(); ++it) {
+
+        const requestMatch &m = it->match;
+
+        if ((pmsg->id & m.mask) != (m.id & m.mask)) {
+            continue;
+        }
+
+        if ((pmsg->flags & m.flagsMask) != (m.flags & m.flagsMask)) {
+            continue;
+        }
+
+        bool bMatch = true;
+        for (int i = 0; (i < 8) && bMatch; i++) {
+            if (m.dataMask & (1 << i)) {
+                bMatch = (i < pmsg->sizeData) && (pmsg->data[i] == m.data[i]);
+            }
+        }
+
+        if (bMatch) {
+            void *puser = it->puser;
+            m_requests.erase(it);
+            m_cntPending = m_requests.size();
+            return puser;
+        }
+    }
+
+    return NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// expire
+//
+
+void
+CRequestMatcher::expire(std::vector<void *> &expired)
+{
+    if (!m_cntPending) {
+        return;
+    }
+
+    clock::time_point now = clock::now();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (auto it = m_requests.begin(); it != m_requests.end();) {
+        if (it->deadline <= now) {
+            expired.push_back(it->puser);
+            it = m_requests.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+
+    m_cntPending = m_requests.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// clear
+//
+
+void
+CRequestMatcher::clear(std::vector<void *> &removed)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (auto it = m_requests.begin(); it != m_requests.end(); ++it) {
+        removed.push_back(it->puser);
+    }
+
+    m_requests.clear();
+    m_cntPending = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// nextTimeout
+//
+
+uint32_t
+CRequestMatcher::nextTimeout(uint32_t maxwait)
+{
+    if (!m_cntPending) {
+        return maxwait;
+    }
+
+    clock::time_point now = clock::now();
+    clock::time_point first = now + std::chrono::milliseconds(maxwait);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (auto it = m_requests.begin(); it != m_requests.end(); ++it) {
+        if (it->deadline < first) {
+            first = it->deadline;
+        }
+    }
+
+    // Zero is forever for CANAL blocking calls
+    if (first <= now) {
+        return 1;
+    }
+
+    // Round up so we do not wake just before the deadline
+    return (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+             first - now + std::chrono::microseconds(999))
+      .count();
+}
@@ -0,0 +1,144 @@
+///////////////////////////////////////////////////////////////////////////
+// reqmatch.h
+//
+// Request/response correlation. Outstanding requests are matched
+// against received frames in the receive thread.
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#if !defined(REQMATCH_H)
+#define REQMATCH_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <mutex>
+#include <vector>
+
+#include "canal.h"
+
+/*!
+    What a response must look like to match a request
+*/
+typedef struct structRequestMatch {
+    uint32_t id;                        // Expected id
+    uint32_t mask;                      // Bits of id to compare
+    uint8_t data[8];                    // Expected data bytes
+    uint8_t dataMask;                   // Bit n set = compare data[n]
+    uint32_t flags;                     // Expected flags
+    uint32_t flagsMask;                 // Bits of flags to compare
+} requestMatch;
+
+class CRequestMatcher {
+
+public:
+
+    CRequestMatcher();
+    ~CRequestMatcher();
+
+    /*!
+        Add an outstanding request. Must be done before the request
+        is sent so a fast response is not missed.
+
+        @param pmatch What the response looks like
+        @param timeout Timeout in milliseconds
+        @param puser User data returned on match or timeout
+    */
+    void add(const requestMatch *pmatch, uint32_t timeout, void *puser);
+
+    /*!
+        Remove an outstanding request
+
+        @param puser User data given to add
+        @return True if the request was found
+    */
+    bool remove(void *puser);
+
+    /*!
+        Match a received frame against outstanding requests. The
+        oldest matching request is removed. Status frames from the
+        driver never match.
+
+        @param pmsg Received frame
+        @return User data of the matched request or NULL
+    */
+    void *match(const canalMsg *pmsg);
+
+    /*!
+        Remove timed out requests
+
+        @param expired Receives user data of timed out requests
+    */
+    void expire(std::vector<void *> &expired);
+
+    /*!
+        Remove all requests
+
+        @param removed Receives user data of all requests
+    */
+    void clear(std::vector<void *> &removed);
+
+    /*!
+        Get time to the first timeout
+
+        @param maxwait Longest time to return
+        @return Milliseconds until the first request times out,
+                    at most maxwait and never zero.
+    */
+    uint32_t nextTimeout(uint32_t maxwait);
+
+    /*!
+        Check if there are outstanding requests
+
+        @return True if there are
+    */
+    bool isPending(void) { return (0 != m_cntPending); };
+
+private:
+
+    typedef std::chrono::steady_clock clock;
+
+    // An outstanding request
+    typedef struct {
+        requestMatch match;
+        clock::time_point deadline;
+        void *puser;
+    } pendingRequest;
+
+    // Protects request list
+    std::mutex m_mutex;
+
+    // Outstanding requests in order of arrival
+    std::list<pendingRequest> m_requests;
+
+    // Size of m_requests, readable without the lock
+    std::atomic<uint32_t> m_cntPending;
+};
+
+#endif
@@ -0,0 +1,196 @@
+///////////////////////////////////////////////////////////////////////////
+// rtsched.cpp
+//
+// Real-time scheduling, CPU pinning and memory locking for the
+// native I/O threads.
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <alloca.h>
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <syslog.h>
+#include <unistd.h>
+
+#include <thread>
+
+#include "canal.h"
+#include "rtsched.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// rtInitTuning
+//
+
+void
+rtInitTuning(threadTuning *ptuning)
+{
+    ptuning->policy        = SCHED_OTHER;
+    ptuning->priority      = 0;
+    ptuning->cpus.clear();
+    ptuning->bLockMemory   = false;
+    ptuning->prefaultStack = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// setScheduling
+//
+// Set policy/priority and affinity of the calling thread. Returns an
+// errno value.
+//
+
+static int
+setScheduling(const threadTuning *ptuning, std::string &strError)
+{
+    int rv;
+
+    if (SCHED_OTHER != ptuning->policy) {
+        struct sched_param param;
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = ptuning->priority;
+        rv = pthread_setschedparam(pthread_self(), ptuning->policy, &param);
+        if (rv) {
+            strError = std::string((SCHED_FIFO == ptuning->policy) ?
+                                        "SCHED_FIFO" : "SCHED_RR") +
+                       " priority " + std::to_string(ptuning->priority) +
+                       " failed: " + strerror(rv);
+            if (EPERM == rv) {
+                strError += ". Needs CAP_SYS_NICE or an RLIMIT_RTPRIO"
+                            " of at least the priority (ulimit -r).";
+            }
+            return rv;
+        }
+    }
+
+    if (ptuning->cpus.size()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : ptuning->cpus) {
+            CPU_SET(cpu, &set);
+        }
+        rv = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (rv) {
+            strError = std::string("Pinning to CPU set failed: ") + strerror(rv);
+            return rv;
+        }
+    }
+
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// rtCheckTuning
+//
+
+int
+rtCheckTuning(const threadTuning *ptuning, std::string &strError)
+{
+    if (NULL == ptuning) {
+        strError = "No tuning given";
+        return CANAL_ERROR_PARAMETER;
+    }
+
+    if ((SCHED_FIFO == ptuning->policy) || (SCHED_RR == ptuning->policy)) {
+        int min = sched_get_priority_min(ptuning->policy);
+        int max = sched_get_priority_max(ptuning->policy);
+        if ((ptuning->priority < min) || (ptuning->priority > max)) {
+            strError = "Real-time priority must be " + std::to_string(min) +
+                       "-" + std::to_string(max);
+            return CANAL_ERROR_PARAMETER;
+        }
+    }
+    else if (SCHED_OTHER != ptuning->policy) {
+        strError = "Unknown scheduling policy";
+        return CANAL_ERROR_PARAMETER;
+    }
+
+    long cntCpu = sysconf(_SC_NPROCESSORS_CONF);
+    for (int cpu : ptuning->cpus) {
+        if ((cpu < 0) || (cpu >= cntCpu) || (cpu >= CPU_SETSIZE)) {
+            strError = "No CPU " + std::to_string(cpu);
+            return CANAL_ERROR_PARAMETER;
+        }
+    }
+
+    // Try on a thread of its own, the caller keep its scheduling
+    int err = 0;
+    std::thread test([ptuning, &err, &strError] {
+        err = setScheduling(ptuning, strError);
+    });
+    test.join();
+
+    if (err) {
+        return (EPERM == err) ? CANAL_ERROR_NOT_SUPPORTED : CANAL_ERROR_PARAMETER;
+    }
+
+    if (ptuning->bLockMemory && mlockall(MCL_CURRENT | MCL_FUTURE)) {
+        err = errno;
+        strError = std::string("mlockall failed: ") + strerror(err);
+        if ((EPERM == err) || (ENOMEM == err)) {
+            strError += ". Needs CAP_IPC_LOCK or a larger RLIMIT_MEMLOCK"
+                        " (ulimit -l).";
+        }
+        return CANAL_ERROR_NOT_SUPPORTED;
+    }
+
+    return CANAL_ERROR_SUCCESS;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// rtApplyTuning
+//
+
+int
+rtApplyTuning(const threadTuning *ptuning)
+{
+    if (NULL == ptuning) {
+        return CANAL_ERROR_PARAMETER;
+    }
+
+    std::string strError;
+    if (setScheduling(ptuning, strError)) {
+        syslog(LOG_ERR, "%s", strError.c_str());
+        return CANAL_ERROR_NOT_SUPPORTED;
+    }
+
+    // Touch the stack now so the first frames don't page fault
+    uint32_t size = ptuning->prefaultStack;
+    if (size > RTSCHED_MAX_PREFAULT) {
+        size = RTSCHED_MAX_PREFAULT;
+    }
+    if (size) {
+        volatile uint8_t *p = (volatile uint8_t *)alloca(size);
+        long pagesize = sysconf(_SC_PAGESIZE);
+        for (uint32_t i = 0; i < size; i += pagesize) {
+            p[i] = 0;
+        }
+    }
+
+    return CANAL_ERROR_SUCCESS;
+}
@@ -0,0 +1,85 @@
+///////////////////////////////////////////////////////////////////////////
+// rtsched.h
+//
+// Real-time scheduling, CPU pinning and memory locking for the
+// native I/O threads.
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#if !defined(RTSCHED_H)
+#define RTSCHED_H
+
+#include <stdint.h>
+#include <sched.h>
+
+#include <string>
+#include <vector>
+
+// Largest stack area pre-faulted in a thread
+#define RTSCHED_MAX_PREFAULT        (1024 * 1024)
+
+/*!
+    How native I/O threads (receive, stream, broadcast and periodic
+    transmit) are scheduled. The default leaves threads as created.
+*/
+typedef struct structThreadTuning {
+    int policy;                         // SCHED_OTHER, SCHED_FIFO or SCHED_RR
+    int priority;                       // 1-99 for SCHED_FIFO/SCHED_RR
+    std::vector<int> cpus;              // CPUs to pin to, empty for any
+    bool bLockMemory;                   // mlockall current and future pages
+    uint32_t prefaultStack;             // Bytes of stack to touch at start
+} threadTuning;
+
+/*!
+    Set tuning to defaults
+
+    @param ptuning Tuning to reset
+*/
+void rtInitTuning(threadTuning *ptuning);
+
+/*!
+    Check tuning before any thread use it. Scheduling and affinity
+    are tried on a short lived thread so the caller is not affected.
+    Memory is locked here as it is process wide.
+
+    @param ptuning Tuning to check
+    @param strError Receives a description of what failed
+    @return CANAL_ERROR_SUCCESS, CANAL_ERROR_PARAMETER for invalid
+                values or CANAL_ERROR_NOT_SUPPORTED when the process
+                lacks the privilege.
+*/
+int rtCheckTuning(const threadTuning *ptuning, std::string &strError);
+
+/*!
+    Apply tuning to the calling thread. Failures are logged to syslog.
+
+    @param ptuning Tuning to apply
+    @return CANAL_ERROR_SUCCESS on success
+*/
+int rtApplyTuning(const threadTuning *ptuning);
+
+#endif
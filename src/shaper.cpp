@@ -0,0 +1,159 @@
+///////////////////////////////////////////////////////////////////////////
+// shaper.cpp
+//
+// Transmit shaper. Token buckets limiting frames and bits per second
+// with bursts.
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <string.h>
+
+#include "busload.h"
+#include "shaper.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// constructor
+//
+
+CTxShaper::CTxShaper()
+{
+    shaperRate rate;
+    memset(&rate, 0, sizeof(shaperRate));
+    rate.burstFrames = SHAPER_DEFAULT_BURST_FRAMES;
+    rate.burstBits = SHAPER_DEFAULT_BURST_BITS;
+    setRate(&rate);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// deconstructor
+//
+
+CTxShaper::~CTxShaper()
+{
+    ;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// setRate
+//
+
+void
+CTxShaper::setRate(const shaperRate *prate)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_rate = *prate;
+
+    // A bucket must hold at least one frame
+    if (0 == m_rate.burstFrames) {
+        m_rate.burstFrames = 1;
+    }
+    if (m_rate.burstBits < 160) {
+        m_rate.burstBits = 160;
+    }
+
+    m_bEnabled = (m_rate.framesPerSec > 0) || (m_rate.bitsPerSec > 0);
+    m_frameTokens = m_rate.burstFrames;
+    m_bitTokens = m_rate.burstBits;
+    m_lastRefill = clock::now();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getRate
+//
+
+void
+CTxShaper::getRate(shaperRate *prate)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    *prate = m_rate;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// refill
+//
+
+void
+CTxShaper::refill(clock::time_point now)
+{
+    double sec = std::chrono::duration<double>(now - m_lastRefill).count();
+    m_lastRefill = now;
+
+    m_frameTokens += sec * m_rate.framesPerSec;
+    if (m_frameTokens > m_rate.burstFrames) {
+        m_frameTokens = m_rate.burstFrames;
+    }
+
+    m_bitTokens += sec * m_rate.bitsPerSec;
+    if (m_bitTokens > m_rate.burstBits) {
+        m_bitTokens = m_rate.burstBits;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// acquire
+//
+
+uint64_t
+CTxShaper::acquire(const canalMsg *pmsg)
+{
+    if (!m_bEnabled) {
+        return 0;
+    }
+
+    double bits = CBusLoad::frameBits(pmsg, BUSLOAD_STUFF_COMPUTED);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    refill(clock::now());
+
+    // Time until each bucket has enough, the longest wins
+    double waitSec = 0;
+    if ((m_rate.framesPerSec > 0) && (m_frameTokens < 1)) {
+        waitSec = (1 - m_frameTokens) / m_rate.framesPerSec;
+    }
+    if ((m_rate.bitsPerSec > 0) && (m_bitTokens < bits)) {
+        double sec = (bits - m_bitTokens) / m_rate.bitsPerSec;
+        if (sec > waitSec) {
+            waitSec = sec;
+        }
+    }
+
+    if (waitSec > 0) {
+        // Round up so the caller does not wake up too early
+        return (uint64_t)(waitSec * 1000000) + 1;
+    }
+
+    if (m_rate.framesPerSec > 0) {
+        m_frameTokens -= 1;
+    }
+    if (m_rate.bitsPerSec > 0) {
+        m_bitTokens -= bits;
+    }
+
+    return 0;
+}
@@ -0,0 +1,116 @@
+///////////////////////////////////////////////////////////////////////////
+// shaper.h
+//
+// Transmit shaper. Token buckets limiting frames and bits per second
+// with bursts.
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#if !defined(SHAPER_H)
+#define SHAPER_H
+
+#include <stdint.h>
+
+#include <chrono>
+#include <mutex>
+
+#include "canal.h"
+
+// Default bursts
+#define SHAPER_DEFAULT_BURST_FRAMES     16
+#define SHAPER_DEFAULT_BURST_BITS       (16 * 160)  // Worst case extended frames
+
+/*!
+    Limits for the transmit shaper. Zero rates are unlimited.
+*/
+typedef struct structShaperRate {
+    uint32_t framesPerSec;              // Max frames per second
+    uint32_t bitsPerSec;                // Max on-wire bits per second
+    uint32_t burstFrames;               // Frames that can go back to back
+    uint32_t burstBits;                 // Bits that can go back to back
+} shaperRate;
+
+/*!
+    Two token buckets, one for frames and one for on-wire bits. A
+    frame may go when both buckets hold enough tokens. Thread safe.
+*/
+class CTxShaper {
+
+public:
+
+    typedef std::chrono::steady_clock clock;
+
+    CTxShaper();
+    ~CTxShaper();
+
+    /*!
+        Set limits. The buckets start full.
+
+        @param prate Limits, zero rates are unlimited
+    */
+    void setRate(const shaperRate *prate);
+
+    /*!
+        Get limits
+
+        @param prate Receives the limits
+    */
+    void getRate(shaperRate *prate);
+
+    /*!
+        Check if the shaper limits anything
+
+        @return True if a rate is set
+    */
+    bool isEnabled(void) { return m_bEnabled; };
+
+    /*!
+        Take tokens for a frame if there are enough
+
+        @param pmsg Frame to send
+        @return Zero if the frame may go now and tokens were taken,
+                    else microseconds until it may go
+    */
+    uint64_t acquire(const canalMsg *pmsg);
+
+private:
+
+    // Add tokens for the time since last refill. Lock must be held.
+    void refill(clock::time_point now);
+
+    // Protects everything below
+    std::mutex m_mutex;
+
+    bool m_bEnabled;
+    shaperRate m_rate;
+
+    double m_frameTokens;
+    double m_bitTokens;
+    clock::time_point m_lastRefill;
+};
+
+#endif
@@ -0,0 +1,283 @@
+///////////////////////////////////////////////////////////////////////////
+// statuswatch.cpp
+//
+// Channel state watcher. Polls status and statistics from a native
+// thread and reports only when the state changes.
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <string.h>
+
+#include <chrono>
+
+#include "statuswatch.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// constructor
+//
+
+CStatusWatcher::CStatusWatcher()
+{
+    m_pif = NULL;
+    m_periodMs = STATUSWATCH_DEFAULT_PERIOD_MS;
+    memset(&m_state, 0, sizeof(channelState));
+    m_bState = false;
+    m_bQuit = false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// deconstructor
+//
+
+CStatusWatcher::~CStatusWatcher()
+{
+    stop();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// decodeState
+//
+
+int
+CStatusWatcher::decodeState(uint32_t channelStatus)
+{
+    if (channelStatus & CANAL_STATUS_BUS_OFF) {
+        return CHANNEL_STATE_BUS_OFF;
+    }
+    if (channelStatus & CANAL_STATUS_PASSIVE) {
+        return CHANNEL_STATE_PASSIVE;
+    }
+    if (channelStatus & CANAL_STATUS_BUS_WARN) {
+        return CHANNEL_STATE_WARNING;
+    }
+    if (channelStatus & CANAL_STATUS_ACTIVE) {
+        return CHANNEL_STATE_ACTIVE;
+    }
+    if (channelStatus & CANAL_STATUS_STOPPED) {
+        return CHANNEL_STATE_STOPPED;
+    }
+    if (channelStatus & CANAL_STATUS_SLEEPING) {
+        return CHANNEL_STATE_SLEEPING;
+    }
+
+    return CHANNEL_STATE_UNKNOWN;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// stateName
+//
+
+const char *
+CStatusWatcher::stateName(int state)
+{
+    switch (state) {
+        case CHANNEL_STATE_ERROR:
+            return "error";
+        case CHANNEL_STATE_CLOSED:
+            return "closed";
+        case CHANNEL_STATE_BUS_OFF:
+            return "busoff";
+        case CHANNEL_STATE_PASSIVE:
+            return "passive";
+        case CHANNEL_STATE_WARNING:
+            return "warning";
+        case CHANNEL_STATE_ACTIVE:
+            return "active";
+        case CHANNEL_STATE_STOPPED:
+            return "stopped";
+        case CHANNEL_STATE_SLEEPING:
+            return "sleeping";
+        default:
+            return "unknown";
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// start
+//
+
+int
+CStatusWatcher::start(CCanalIf *pif,
+                        uint32_t periodMs,
+                        std::function<void(const channelState *)> callback)
+{
+    if ((NULL == pif) || !callback) {
+        return CANAL_ERROR_PARAMETER;
+    }
+
+    if (m_thread.joinable()) {
+        return CANAL_ERROR_INIT_READY;
+    }
+
+    if (periodMs < STATUSWATCH_MIN_PERIOD_MS) {
+        periodMs = STATUSWATCH_MIN_PERIOD_MS;
+    }
+
+    m_pif = pif;
+    m_periodMs = periodMs;
+    m_callback = callback;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_bState = false;
+        m_bQuit = false;
+    }
+    m_thread = std::thread(&CStatusWatcher::workThread, this);
+
+    return CANAL_ERROR_SUCCESS;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// stop
+//
+
+void
+CStatusWatcher::stop(void)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_bQuit = true;
+    }
+    m_cv.notify_one();
+
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+
+    m_callback = nullptr;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getState
+//
+
+bool
+CStatusWatcher::getState(channelState *pstate)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (!m_bState) {
+        return false;
+    }
+
+    memcpy(pstate, &m_state, sizeof(channelState));
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// poll
+//
+
+void
+CStatusWatcher::poll(channelState *pstate)
+{
+    memset(pstate, 0, sizeof(channelState));
+
+    pstate->rv = m_pif->CanalGetStatus(&pstate->status);
+    if (CANAL_ERROR_SUCCESS != pstate->rv) {
+        pstate->state = (CANAL_ERROR_NOT_OPEN == pstate->rv) ?
+                            CHANNEL_STATE_CLOSED : CHANNEL_STATE_ERROR;
+        return;
+    }
+
+    uint32_t channelStatus = (uint32_t)pstate->status.channel_status;
+    pstate->state = decodeState(channelStatus);
+
+    // Low bits hold the error counters, transmit in the low byte
+    pstate->txErrors = channelStatus & 0xff;
+    pstate->rxErrors = (channelStatus >> 8) & 0xff;
+
+    pstate->bStatistics =
+        (CANAL_ERROR_SUCCESS == m_pif->CanalGetStatistics(&pstate->statistics));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// isChanged
+//
+
+bool
+CStatusWatcher::isChanged(const channelState *pold, const channelState *pnew)
+{
+    if ((pold->rv != pnew->rv) || (pold->state != pnew->state)) {
+        return true;
+    }
+
+    // Error counters move all the time, the flags do not
+    if ((pold->status.channel_status & CHANNEL_STATUS_FLAGS) !=
+        (pnew->status.channel_status & CHANNEL_STATUS_FLAGS)) {
+        return true;
+    }
+
+    // Statistics counters are only reported along with a change
+    // of the above. Overruns can change with every poll.
+    return (pold->status.lasterrorcode != pnew->status.lasterrorcode) ||
+           (pold->status.lasterrorsubcode != pnew->status.lasterrorsubcode);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// workThread
+//
+
+void
+CStatusWatcher::workThread(void)
+{
+    typedef std::chrono::steady_clock clock;
+
+    channelState state;
+    clock::time_point next = clock::now();
+
+    for (;;) {
+
+        poll(&state);
+
+        bool bChanged;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            bChanged = !m_bState || isChanged(&m_state, &state);
+            memcpy(&m_state, &state, sizeof(channelState));
+            m_bState = true;
+        }
+
+        if (bChanged) {
+            m_callback(&state);
+        }
+
+        // Absolute deadlines so the poll rate does not drift
+        next += std::chrono::milliseconds(m_periodMs);
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_cv.wait_until(lock, next, [this] { return m_bQuit; })) {
+            break;
+        }
+
+        // Do not try to catch up after a stall
+        clock::time_point now = clock::now();
+        if (next < now) {
+            next = now;
+        }
+    }
+}
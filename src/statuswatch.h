@@ -0,0 +1,168 @@
+///////////////////////////////////////////////////////////////////////////
+// statuswatch.h
+//
+// Channel state watcher. Polls status and statistics from a native
+// thread and reports only when the state changes.
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#if !defined(STATUSWATCH_H)
+#define STATUSWATCH_H
+
+#include <stdint.h>
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "canalif.h"
+
+// Shortest allowed poll period
+#define STATUSWATCH_MIN_PERIOD_MS   1
+
+// Default poll period
+#define STATUSWATCH_DEFAULT_PERIOD_MS   100
+
+// Channel states, worst first when several status bits are set
+#define CHANNEL_STATE_ERROR         0   // Status could not be read
+#define CHANNEL_STATE_CLOSED        1   // Channel not open
+#define CHANNEL_STATE_BUS_OFF       2
+#define CHANNEL_STATE_PASSIVE       3
+#define CHANNEL_STATE_WARNING       4
+#define CHANNEL_STATE_ACTIVE        5
+#define CHANNEL_STATE_STOPPED       6
+#define CHANNEL_STATE_SLEEPING      7
+#define CHANNEL_STATE_UNKNOWN       8   // No state bits set
+
+// Status bits that are not error counters
+#define CHANNEL_STATUS_FLAGS        0xffff0000
+
+/*!
+    State of a channel as seen by one poll
+*/
+typedef struct structChannelState {
+    int rv;                             // Result of CanalGetStatus
+    int state;                          // CHANNEL_STATE_*
+    uint32_t txErrors;                  // Transmit error counter
+    uint32_t rxErrors;                  // Receive error counter
+    canalStatus status;
+    bool bStatistics;                   // True if statistics are valid
+    canalStatistics statistics;
+} channelState;
+
+/*!
+    Polls the channel status and statistics at a fixed rate and
+    calls back when the state, the status flags, the last error
+    or the overrun/warning/bus off counters change.
+*/
+class CStatusWatcher {
+
+public:
+
+    CStatusWatcher();
+    ~CStatusWatcher();
+
+    /*!
+        Decode the state from a status word
+
+        @param channelStatus channel_status from CanalGetStatus
+        @return CHANNEL_STATE_*
+    */
+    static int decodeState(uint32_t channelStatus);
+
+    /*!
+        Name of a state
+
+        @param state CHANNEL_STATE_*
+        @return Name, "unknown" for unknown states
+    */
+    static const char *stateName(int state);
+
+    /*!
+        Start polling. The callback is called from the watcher
+        thread, first with the state found when started.
+
+        @param pif CANAL interface to poll
+        @param periodMs Poll period in milliseconds
+        @param callback Called with each new state
+        @return CANAL_ERROR_SUCCESS on success, CANAL error code on failure
+    */
+    int start(CCanalIf *pif,
+                uint32_t periodMs,
+                std::function<void(const channelState *)> callback);
+
+    /*!
+        Stop polling. The callback is not called after this returns.
+    */
+    void stop(void);
+
+    /*!
+        Check if polling
+
+        @return True if the watcher thread runs
+    */
+    bool isRunning(void) { return m_thread.joinable(); };
+
+    /*!
+        Get the state from the last poll
+
+        @param pstate Receives the state
+        @return True if there has been a poll
+    */
+    bool getState(channelState *pstate);
+
+private:
+
+    // Poll once
+    void poll(channelState *pstate);
+
+    // True if the change is worth a callback
+    static bool isChanged(const channelState *pold, const channelState *pnew);
+
+    // Watcher thread
+    void workThread(void);
+
+    CCanalIf *m_pif;
+    uint32_t m_periodMs;
+    std::function<void(const channelState *)> m_callback;
+
+    // Protects everything below
+    std::mutex m_mutex;
+
+    // Signalled when the thread should quit
+    std::condition_variable m_cv;
+
+    // State from last poll
+    channelState m_state;
+    bool m_bState;
+
+    bool m_bQuit;
+    std::thread m_thread;
+};
+
+#endif
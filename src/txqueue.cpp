@@ -0,0 +1,192 @@
+///////////////////////////////////////////////////////////////////////////
+// txqueue.cpp
+//
+// Send queue. Bounded heap of frames ordered by priority class and
+// optionally by CAN arbitration.
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "txqueue.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// constructor
+//
+
+CTxQueue::CTxQueue(size_t capacity)
+{
+    m_order = TXQUEUE_ORDER_FIFO;
+    m_seq = 0;
+    setCapacity(capacity);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// deconstructor
+//
+
+CTxQueue::~CTxQueue()
+{
+    ;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// arbitrationKey
+//
+
+uint32_t
+CTxQueue::arbitrationKey(const canalMsg *pmsg)
+{
+    uint32_t rtr = (pmsg->flags & CANAL_IDFLAG_RTR) ? 1 : 0;
+
+    // Base id, then RTR/SRR, IDE, extended id and RTR as sent
+    if (pmsg->flags & CANAL_IDFLAG_EXTENDED) {
+        uint32_t id = pmsg->id & 0x1fffffff;
+        return ((id >> 18) << 21) | (1 << 20) | (1 << 19) |
+               ((id & 0x3ffff) << 1) | rtr;
+    }
+
+    return ((pmsg->id & 0x7ff) << 21) | (rtr << 20);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// setCapacity
+//
+
+void
+CTxQueue::setCapacity(size_t capacity)
+{
+    if (0 == capacity) {
+        capacity = 1;
+    }
+
+    m_heap.clear();
+    m_heap.shrink_to_fit();
+    m_heap.reserve(capacity);
+    m_capacity = capacity;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// isAfter
+//
+
+bool
+CTxQueue::isAfter(const txFrame &a, const txFrame &b)
+{
+    if (a.priority != b.priority) {
+        return a.priority > b.priority;
+    }
+
+    if (a.key != b.key) {
+        return a.key > b.key;
+    }
+
+    return a.seq > b.seq;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// push
+//
+
+bool
+CTxQueue::push(const canalMsg *pmsg, uint8_t priority)
+{
+    if (isFull()) {
+        return false;
+    }
+
+    if (priority > TXQUEUE_PRIORITY_LOWEST) {
+        priority = TXQUEUE_PRIORITY_LOWEST;
+    }
+
+    m_heap.emplace_back();
+    txFrame &frame = m_heap.back();
+    memcpy(&frame.msg, pmsg, sizeof(canalMsg));
+    frame.queued = std::chrono::steady_clock::now();
+    frame.priority = priority;
+    frame.key = (TXQUEUE_ORDER_ID == m_order) ? arbitrationKey(pmsg) : 0;
+    frame.seq = m_seq++;
+
+    std::push_heap(m_heap.begin(), m_heap.end(), isAfter);
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// putBack
+//
+
+void
+CTxQueue::putBack(const txFrame *pframe)
+{
+    m_heap.push_back(*pframe);
+    std::push_heap(m_heap.begin(), m_heap.end(), isAfter);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// pop
+//
+
+bool
+CTxQueue::pop(txFrame *pframe)
+{
+    if (m_heap.empty()) {
+        return false;
+    }
+
+    std::pop_heap(m_heap.begin(), m_heap.end(), isAfter);
+    *pframe = m_heap.back();
+    m_heap.pop_back();
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// expire
+//
+
+size_t
+CTxQueue::expire(std::chrono::steady_clock::time_point oldest)
+{
+    size_t cnt = m_heap.size();
+
+    m_heap.erase(std::remove_if(m_heap.begin(),
+                                m_heap.end(),
+                                [oldest](const txFrame &frame) {
+                                    return frame.queued < oldest;
+                                }),
+                    m_heap.end());
+
+    cnt -= m_heap.size();
+    if (cnt) {
+        std::make_heap(m_heap.begin(), m_heap.end(), isAfter);
+    }
+
+    return cnt;
+}
@@ -0,0 +1,153 @@
+///////////////////////////////////////////////////////////////////////////
+// txqueue.h
+//
+// Send queue. Bounded heap of frames ordered by priority class and
+// optionally by CAN arbitration.
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#if !defined(TXQUEUE_H)
+#define TXQUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <chrono>
+#include <vector>
+
+#include "canal.h"
+
+// Order within a priority class
+#define TXQUEUE_ORDER_FIFO          0   // As queued
+#define TXQUEUE_ORDER_ID            1   // As the bus arbitrates, low id first
+
+// Priority classes, lower is sent first
+#define TXQUEUE_PRIORITY_HIGHEST    0
+#define TXQUEUE_PRIORITY_LOWEST     7
+#define TXQUEUE_PRIORITY_DEFAULT    4
+
+/*!
+    A frame waiting in the send queue
+*/
+typedef struct structTxFrame {
+    canalMsg msg;
+    std::chrono::steady_clock::time_point queued;   // When it was queued
+    uint8_t priority;                   // Priority class
+    uint32_t key;                       // Arbitration key, 0 in FIFO order
+    uint64_t seq;                       // Queue order
+} txFrame;
+
+/*!
+    Bounded send queue. Frames come out by priority class, then by
+    arbitration key if ordered by id, then in the order queued, so
+    frames with the same id are never reordered. Storage is
+    allocated once. Not thread safe, the owner lock it.
+*/
+class CTxQueue {
+
+public:
+
+    CTxQueue(size_t capacity = 1000);
+    ~CTxQueue();
+
+    /*!
+        Arbitration key of a frame. Compares as the id, SRR, IDE
+        and RTR bits compare on the bus.
+
+        @param pmsg Frame
+        @return Key, lower wins arbitration
+    */
+    static uint32_t arbitrationKey(const canalMsg *pmsg);
+
+    /*!
+        Change capacity. Frames in the queue are dropped.
+
+        @param capacity Max number of frames
+    */
+    void setCapacity(size_t capacity);
+
+    /*!
+        Set order within a priority class. Use on an empty queue.
+
+        @param order TXQUEUE_ORDER_*
+    */
+    void setOrder(int order) { m_order = order; };
+
+    /*!
+        Add a frame
+
+        @param pmsg Frame to add
+        @param priority Priority class, TXQUEUE_PRIORITY_*
+        @return False if the queue is full
+    */
+    bool push(const canalMsg *pmsg, uint8_t priority = TXQUEUE_PRIORITY_DEFAULT);
+
+    /*!
+        Put back a frame taken with pop. It gets its old place and
+        may exceed the capacity by the frames taken.
+
+        @param pframe Frame from pop
+    */
+    void putBack(const txFrame *pframe);
+
+    /*!
+        Remove the frame to send next
+
+        @param pframe Receives the frame
+        @return False if the queue is empty
+    */
+    bool pop(txFrame *pframe);
+
+    /*!
+        Drop frames queued before a time
+
+        @param oldest Frames queued before this are dropped
+        @return Number of frames dropped
+    */
+    size_t expire(std::chrono::steady_clock::time_point oldest);
+
+    /*!
+        Drop all frames
+    */
+    void clear(void) { m_heap.clear(); };
+
+    size_t size(void) const { return m_heap.size(); };
+    bool isEmpty(void) const { return m_heap.empty(); };
+    bool isFull(void) const { return m_heap.size() >= m_capacity; };
+
+private:
+
+    // Heap order, true if a goes after b
+    static bool isAfter(const txFrame &a, const txFrame &b);
+
+    std::vector<txFrame> m_heap;
+    size_t m_capacity;
+    int m_order;
+    uint64_t m_seq;
+};
+
+#endif
@@ -0,0 +1,131 @@
+///////////////////////////////////////////////////////////////////////////
+// vscpl1.cpp
+//
+// VSCP Level I CAN identifier decoding and class/type/nickname
+// filtering.
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <string.h>
+
+#include "vscpl1.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// constructor
+//
+
+CVscpLevel1::CVscpLevel1()
+{
+    std::vector<uint32_t> all;
+
+    m_bEnable     = false;
+    m_cntFiltered = 0;
+
+    setFilter(all, all, all);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// deconstructor
+//
+
+CVscpLevel1::~CVscpLevel1()
+{
+    ;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// decode
+//
+
+void
+CVscpLevel1::decode(const canalMsg *pmsg, vscpLevel1Msg *pvscp)
+{
+    memcpy(&pvscp->msg, pmsg, sizeof(canalMsg));
+
+    pvscp->priority   = (pmsg->id >> 26) & 0x07;
+    pvscp->bHardcoded = (pmsg->id >> 25) & 0x01;
+    pvscp->vscpClass  = (pmsg->id >> 16) & 0x1ff;
+    pvscp->vscpType   = (pmsg->id >> 8) & 0xff;
+    pvscp->nickname   = pmsg->id & 0xff;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// fillSet
+//
+
+void
+CVscpLevel1::fillSet(uint32_t *pset,
+                        uint32_t size,
+                        const std::vector<uint32_t> &values)
+{
+    if (values.empty()) {
+        memset(pset, 0xff, size / 8);
+        return;
+    }
+
+    memset(pset, 0, size / 8);
+    for (uint32_t value : values) {
+        if (value < size) {
+            pset[value >> 5] |= (1u << (value & 0x1f));
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// setFilter
+//
+
+void
+CVscpLevel1::setFilter(const std::vector<uint32_t> &classes,
+                        const std::vector<uint32_t> &types,
+                        const std::vector<uint32_t> &nicknames)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    fillSet(m_classSet, VSCP_LEVEL1_MAX_CLASS, classes);
+    fillSet(m_typeSet, VSCP_LEVEL1_MAX_TYPE, types);
+    fillSet(m_nicknameSet, VSCP_LEVEL1_MAX_NICKNAME, nicknames);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// isWanted
+//
+
+bool
+CVscpLevel1::isWanted(const vscpLevel1Msg *pvscp)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if ((m_classSet[pvscp->vscpClass >> 5] & (1u << (pvscp->vscpClass & 0x1f))) &&
+        (m_typeSet[pvscp->vscpType >> 5] & (1u << (pvscp->vscpType & 0x1f))) &&
+        (m_nicknameSet[pvscp->nickname >> 5] & (1u << (pvscp->nickname & 0x1f)))) {
+        return true;
+    }
+
+    m_cntFiltered++;
+    return false;
+}
@@ -0,0 +1,141 @@
+///////////////////////////////////////////////////////////////////////////
+// vscpl1.h
+//
+// VSCP Level I CAN identifier decoding and class/type/nickname
+// filtering.
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#if !defined(VSCPL1_H)
+#define VSCPL1_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "canal.h"
+
+/*
+    VSCP Level I 29-bit id layout
+
+    Bit 28-26   Priority (0 is highest)
+    Bit 25      Hard coded nickname
+    Bit 24-16   Class (9 bits)
+    Bit 15-8    Type
+    Bit 7-0     Nickname of originator
+*/
+
+#define VSCP_LEVEL1_MAX_CLASS       512
+#define VSCP_LEVEL1_MAX_TYPE        256
+#define VSCP_LEVEL1_MAX_NICKNAME    256
+
+/*!
+    A received frame with a decoded VSCP Level I header
+*/
+typedef struct structVscpLevel1Msg {
+    canalMsg msg;                       // The frame as received
+    uint8_t priority;                   // Priority 0-7
+    bool bHardcoded;                    // Hard coded nickname
+    uint16_t vscpClass;                 // Class 0-511
+    uint8_t vscpType;                   // Type 0-255
+    uint8_t nickname;                   // Originating nickname
+} vscpLevel1Msg;
+
+class CVscpLevel1 {
+
+public:
+
+    CVscpLevel1();
+    ~CVscpLevel1();
+
+    /*!
+        Decode the VSCP Level I header of a frame
+
+        @param pmsg Frame to decode
+        @param pvscp Receives frame and decoded header
+    */
+    static void decode(const canalMsg *pmsg, vscpLevel1Msg *pvscp);
+
+    /*!
+        Enable/disable VSCP processing
+
+        @param bEnable True to enable processing
+    */
+    void enable(bool bEnable) { m_bEnable = bEnable; };
+
+    /*!
+        Check if VSCP processing is enabled
+
+        @return True if enabled
+    */
+    bool isEnabled(void) { return m_bEnable; };
+
+    /*!
+        Set filter. A frame is accepted if its class, type and
+        nickname all is in their sets. An empty set accepts all.
+
+        @param classes Accepted classes
+        @param types Accepted types
+        @param nicknames Accepted originating nicknames
+    */
+    void setFilter(const std::vector<uint32_t> &classes,
+                    const std::vector<uint32_t> &types,
+                    const std::vector<uint32_t> &nicknames);
+
+    /*!
+        Check a decoded frame against the filter
+
+        @param pvscp Decoded frame
+        @return True if the frame should be delivered
+    */
+    bool isWanted(const vscpLevel1Msg *pvscp);
+
+    // Frames dropped by filter
+    std::atomic<uint32_t> m_cntFiltered;
+
+private:
+
+    // Fill a bit set from a list of values (empty list sets all bits)
+    static void fillSet(uint32_t *pset,
+                            uint32_t size,
+                            const std::vector<uint32_t> &values);
+
+    // True if processing is enabled
+    std::atomic<bool> m_bEnable;
+
+    // Protects filter sets
+    std::mutex m_mutex;
+
+    // Filter sets, one bit per accepted value
+    uint32_t m_classSet[VSCP_LEVEL1_MAX_CLASS / 32];
+    uint32_t m_typeSet[VSCP_LEVEL1_MAX_TYPE / 32];
+    uint32_t m_nicknameSet[VSCP_LEVEL1_MAX_NICKNAME / 32];
+};
+
+#endif